@@ -0,0 +1,501 @@
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "uapi_mm.h"
+#include <malloc.h>
+
+/*
+ * zalloc/zfree against glibc calloc/free on parameterized workloads: fixed size churn, random units,
+ * LIFO/FIFO/random free order and a producer/consumer pair of threads. Every run is a forked child,
+ * one pass measures throughput, pages mapped and peak RSS, a second one times every operation
+ *
+ * usage: mm_bench [ops] [live objects] [max units]
+ * output: CSV on stdout, producer/consumer needs a build with MMFLAGS=-DMM_THREAD_SAFE=1 for zalloc
+ */
+
+typedef struct _bench_obj{
+
+    uint8_t payload[48];
+}bench_obj_t;
+
+typedef struct _bench_allocator{
+
+    const char* name;
+    void (*init)(void);
+    void* (*alloc)(int units);
+    void (*free)(void* ptr);
+    uint64_t (*pages_mapped)(void);
+}bench_allocator_t;
+
+typedef struct _bench_ctx{
+
+    const bench_allocator_t* allocator;
+    uint64_t ops;
+    uint32_t live;
+    uint32_t max_units;
+    uint64_t seed;
+    uint64_t done; // operations carried out
+    uint32_t* latency; // ns of every operation, NULL in the throughput pass
+    uint64_t pages_mapped; // sampled at the peak of the live set
+}bench_ctx_t;
+
+typedef struct _bench_workload{
+
+    const char* name;
+    void (*run)(bench_ctx_t* ctx);
+    vm_bool_t threaded;
+}bench_workload_t;
+
+typedef struct _bench_result{
+
+    uint64_t ops;
+    double seconds;
+    uint64_t pages_mapped;
+    long peak_rss_kb;
+    uint32_t p50, p99, p999;
+}bench_result_t;
+
+
+static vm_page_family_t* bench_family = NULL;
+
+
+static void mm_bench_init(void){
+
+    mm_init();
+    bench_family = MM_REG_STRUCT(bench_obj_t);
+}
+
+
+static void* mm_bench_alloc(int units){
+
+    return zalloc_family(bench_family, units);
+}
+
+
+static void mm_bench_free(void* ptr){
+
+    zfree(ptr);
+}
+
+
+static uint64_t mm_bench_pages_mapped(void){
+
+    mm_stats_t stats;
+    mm_family_stats_t family_stats[1];
+    uint64_t pages = 0;
+
+    if(mm_get_stats(&stats, family_stats, 1) == 1){
+
+        pages = family_stats[0].counters.pages;
+    }
+
+    return pages + stats.global_cached_pages;
+}
+
+
+static void glibc_bench_init(void){
+
+}
+
+
+/* zalloc() hands out zeroed objects, so the baseline is calloc() */
+static void* glibc_bench_alloc(int units){
+
+    return calloc((size_t)units, sizeof(bench_obj_t));
+}
+
+
+static void glibc_bench_free(void* ptr){
+
+    free(ptr);
+}
+
+
+static uint64_t glibc_bench_pages_mapped(void){
+
+    struct mallinfo2 info = mallinfo2();
+
+    return (info.arena + info.hblkhd + getpagesize() - 1) / getpagesize();
+}
+
+
+static const bench_allocator_t allocators[] = {
+
+    {"zalloc", mm_bench_init, mm_bench_alloc, mm_bench_free, mm_bench_pages_mapped},
+    {"glibc", glibc_bench_init, glibc_bench_alloc, glibc_bench_free, glibc_bench_pages_mapped},
+};
+
+
+static inline uint64_t now_ns(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+/* xorshift64, the same sequence for every allocator */
+static inline uint32_t next_rand(uint64_t* seed){
+
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return (uint32_t)(*seed >> 32);
+}
+
+
+static inline void* bench_alloc(bench_ctx_t* ctx, uint32_t* latency, int units){
+
+    void* ptr = NULL;
+
+    if(latency){
+
+        uint64_t start = now_ns();
+        ptr = ctx->allocator->alloc(units);
+        latency[ctx->done] = (uint32_t)(now_ns() - start);
+    }else{
+
+        ptr = ctx->allocator->alloc(units);
+    }
+
+    assert(ptr);
+    ctx->done++;
+    return ptr;
+}
+
+
+static inline void bench_free(bench_ctx_t* ctx, uint32_t* latency, void* ptr){
+
+    if(latency){
+
+        uint64_t start = now_ns();
+        ctx->allocator->free(ptr);
+        latency[ctx->done] = (uint32_t)(now_ns() - start);
+    }else{
+
+        ctx->allocator->free(ptr);
+    }
+
+    ctx->done++;
+}
+
+
+/**
+ * keep 'live' objects of 'units' structures, every step frees a random one and allocates its replacement
+ */
+static void churn(bench_ctx_t* ctx, vm_bool_t random_units){
+
+    void** slots = calloc(ctx->live, sizeof(void*));
+    uint32_t i = 0;
+
+    assert(slots);
+
+    for(i=0; i<ctx->live && ctx->done < ctx->ops; i++){
+
+        slots[i] = bench_alloc(ctx, ctx->latency, random_units ? 1 + (int)(next_rand(&ctx->seed) % ctx->max_units) : 1);
+    }
+
+    while(ctx->done + 2 <= ctx->ops){
+
+        i = next_rand(&ctx->seed) % ctx->live;
+        bench_free(ctx, ctx->latency, slots[i]);
+        slots[i] = bench_alloc(ctx, ctx->latency, random_units ? 1 + (int)(next_rand(&ctx->seed) % ctx->max_units) : 1);
+    }
+
+    ctx->pages_mapped = ctx->allocator->pages_mapped();
+
+    /* tearing down is not measured */
+    for(i=0; i<ctx->live; i++){
+
+        if(slots[i]){
+
+            ctx->allocator->free(slots[i]);
+        }
+    }
+
+    free(slots);
+}
+
+
+static void fixed_churn(bench_ctx_t* ctx){
+
+    churn(ctx, MM_FALSE);
+}
+
+
+static void random_units(bench_ctx_t* ctx){
+
+    churn(ctx, MM_TRUE);
+}
+
+
+typedef enum{
+
+    FREE_LIFO,
+    FREE_FIFO,
+    FREE_RANDOM
+}free_order_t;
+
+
+/**
+ * rounds of allocating 'live' objects of random units and freeing all of them in the given order
+ */
+static void free_order(bench_ctx_t* ctx, free_order_t order){
+
+    void** slots = calloc(ctx->live, sizeof(void*));
+    uint32_t* sequence = calloc(ctx->live, sizeof(uint32_t));
+    uint32_t i = 0, j = 0, tmp = 0;
+
+    assert(slots && sequence);
+
+    while(ctx->done + 2 * (uint64_t)ctx->live <= ctx->ops){
+
+        for(i=0; i<ctx->live; i++){
+
+            slots[i] = bench_alloc(ctx, ctx->latency, 1 + (int)(next_rand(&ctx->seed) % ctx->max_units));
+            sequence[i] = order == FREE_LIFO ? ctx->live - 1 - i : i;
+        }
+
+        if(order == FREE_RANDOM){
+
+            for(i=ctx->live-1; i>0; i--){
+
+                j = next_rand(&ctx->seed) % (i + 1);
+                tmp = sequence[i];
+                sequence[i] = sequence[j];
+                sequence[j] = tmp;
+            }
+        }
+
+        if(ctx->pages_mapped == 0){
+
+            ctx->pages_mapped = ctx->allocator->pages_mapped();
+        }
+
+        for(i=0; i<ctx->live; i++){
+
+            bench_free(ctx, ctx->latency, slots[sequence[i]]);
+        }
+    }
+
+    free(sequence);
+    free(slots);
+}
+
+
+static void lifo(bench_ctx_t* ctx){
+
+    free_order(ctx, FREE_LIFO);
+}
+
+
+static void fifo(bench_ctx_t* ctx){
+
+    free_order(ctx, FREE_FIFO);
+}
+
+
+static void random_order(bench_ctx_t* ctx){
+
+    free_order(ctx, FREE_RANDOM);
+}
+
+
+/* single producer single consumer ring of objects, 'live' deep */
+typedef struct _bench_ring{
+
+    bench_ctx_t* ctx;
+    void** slots;
+    uint32_t size;
+    uint64_t head; // written by the producer
+    uint64_t tail; // written by the consumer
+    uint64_t items;
+}bench_ring_t;
+
+
+static void* consumer(void* arg){
+
+    bench_ring_t* ring = arg;
+    bench_ctx_t ctx = *ring->ctx;
+    uint64_t i = 0;
+
+    /* the consumer times its frees into the second half of the latency array */
+    ctx.done = 0;
+    ctx.latency = ring->ctx->latency ? ring->ctx->latency + ring->items : NULL;
+
+    for(i=0; i<ring->items; i++){
+
+        while(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == i){
+
+        }
+
+        bench_free(&ctx, ctx.latency, ring->slots[i % ring->size]);
+        __atomic_store_n(&ring->tail, i + 1, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * one thread allocates objects of random units and hands them over to another thread that frees them,
+ * every free is a remote free for zalloc
+ */
+static void producer_consumer(bench_ctx_t* ctx){
+
+    bench_ring_t ring = {ctx, calloc(ctx->live, sizeof(void*)), ctx->live, 0, 0, ctx->ops / 2};
+    pthread_t thread;
+    uint64_t i = 0;
+
+    assert(ring.slots);
+    pthread_create(&thread, NULL, consumer, &ring);
+
+    for(i=0; i<ring.items; i++){
+
+        while(i - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == ring.size){
+
+        }
+
+        ring.slots[i % ring.size] = bench_alloc(ctx, ctx->latency, 1 + (int)(next_rand(&ctx->seed) % ctx->max_units));
+        __atomic_store_n(&ring.head, i + 1, __ATOMIC_RELEASE);
+
+        if(i + 1 == ring.size){
+
+            ctx->pages_mapped = ctx->allocator->pages_mapped();
+        }
+    }
+
+    pthread_join(thread, NULL);
+    ctx->done += ring.items;
+    free(ring.slots);
+}
+
+
+static const bench_workload_t workloads[] = {
+
+    {"fixed_churn", fixed_churn, MM_FALSE},
+    {"random_units", random_units, MM_FALSE},
+    {"lifo", lifo, MM_FALSE},
+    {"fifo", fifo, MM_FALSE},
+    {"random_order", random_order, MM_FALSE},
+    {"producer_consumer", producer_consumer, MM_TRUE},
+};
+
+
+static int compare_u32(const void* a, const void* b){
+
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+/**
+ * run one pass of a workload in a forked child so that the allocator state and the peak RSS are
+ * its own, the child reports back through a pipe
+ */
+static vm_bool_t run_pass(const bench_workload_t* workload, bench_ctx_t* ctx, vm_bool_t timed, bench_result_t* result){
+
+    int fds[2];
+    pid_t pid = 0;
+    int status = 0;
+
+    if(pipe(fds) == -1 || (pid = fork()) == -1){
+
+        return MM_FALSE;
+    }
+
+    if(pid == 0){
+
+        struct rusage usage;
+        bench_result_t child_result;
+
+        memset(&child_result, 0x0, sizeof(child_result));
+        close(fds[0]);
+        ctx->allocator->init();
+
+        if(timed && (ctx->latency = malloc(ctx->ops * sizeof(uint32_t))) == NULL){
+
+            _exit(1);
+        }
+
+        uint64_t start = now_ns();
+        workload->run(ctx);
+        child_result.seconds = (now_ns() - start) / 1e9;
+        child_result.ops = ctx->done;
+        child_result.pages_mapped = ctx->pages_mapped;
+
+        getrusage(RUSAGE_SELF, &usage);
+        child_result.peak_rss_kb = usage.ru_maxrss;
+
+        if(timed && ctx->done){
+
+            qsort(ctx->latency, ctx->done, sizeof(uint32_t), compare_u32);
+            child_result.p50 = ctx->latency[ctx->done * 50 / 100];
+            child_result.p99 = ctx->latency[ctx->done * 99 / 100];
+            child_result.p999 = ctx->latency[ctx->done * 999 / 1000];
+        }
+
+        _exit(write(fds[1], &child_result, sizeof(child_result)) == sizeof(child_result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    vm_bool_t ok = read(fds[0], result, sizeof(*result)) == sizeof(*result) ? MM_TRUE : MM_FALSE;
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? MM_TRUE : MM_FALSE;
+}
+
+
+int main(int argc, char* argv[]){
+
+    uint64_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+    uint32_t live = argc > 2 ? (uint32_t)atoi(argv[2]) : 10000;
+    uint32_t max_units = argc > 3 ? (uint32_t)atoi(argv[3]) : 8;
+    bench_result_t result, timed_result;
+
+    if(ops < 2 || live == 0 || max_units == 0){
+
+        fprintf(stderr, "usage: %s [ops] [live objects] [max units]\n", argv[0]);
+        return 1;
+    }
+
+    /* the children write to the pipe only */
+    fflush(stdout);
+    printf("workload,allocator,ops,live,max_units,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns,pages_mapped,peak_rss_kb\n");
+
+    for(uint32_t w=0; w<sizeof(workloads)/sizeof(workloads[0]); w++){
+
+        for(uint32_t a=0; a<sizeof(allocators)/sizeof(allocators[0]); a++){
+
+            bench_ctx_t ctx = {&allocators[a], ops, live, max_units, 0x9e3779b97f4a7c15ull, 0, NULL, 0};
+
+#if !MM_THREAD_SAFE
+            if(workloads[w].threaded && allocators[a].init == mm_bench_init){
+
+                fprintf(stderr, "%s: zalloc skipped, build with MMFLAGS=-DMM_THREAD_SAFE=1\n", workloads[w].name);
+                continue;
+            }
+#endif
+
+            fflush(stdout);
+            if(!run_pass(&workloads[w], &ctx, MM_FALSE, &result) || !run_pass(&workloads[w], &ctx, MM_TRUE, &timed_result)){
+
+                fprintf(stderr, "%s: %s failed\n", workloads[w].name, allocators[a].name);
+                continue;
+            }
+
+            printf("%s,%s,%lu,%u,%u,%.4f,%.0f,%u,%u,%u,%lu,%ld\n", workloads[w].name, allocators[a].name,
+                    (unsigned long)result.ops, live, max_units, result.seconds, result.ops / result.seconds,
+                    timed_result.p50, timed_result.p99, timed_result.p999,
+                    (unsigned long)result.pages_mapped, result.peak_rss_kb);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,561 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <linux/ptrace.h>
+#include "uapi_mm.h"
+#include "mm_trace.h"
+
+/*
+ * replay an allocation trace recorded with MMFLAGS=-DMM_TRACE=1 (or MY_TRACE=1 in duke ECE 650/Task1)
+ * against zalloc, glibc and the first/best fit allocators of Task1, at full speed, the timestamps are
+ * not honored. One forked child per allocator times the replay and reports its peak RSS, a second one
+ * runs under ptrace to count the system calls of the replay
+ *
+ * usage: mm_replay <trace file> [zalloc,glibc,ff,bf] [path of libmymalloc.so]
+ * output: CSV on stdout
+ */
+
+typedef struct _replay_allocator{
+
+    const char* name;
+    vm_bool_t (*init)(const mm_trace_header_t* header, const char* lib_path);
+    void* (*alloc)(uint16_t family_id, uint32_t units, uint32_t alignment);
+    void (*free)(void* ptr);
+    void* (*realloc)(void* ptr, uint16_t family_id, uint32_t units);
+}replay_allocator_t;
+
+typedef struct _replay_trace{
+
+    const mm_trace_header_t* header;
+    uint64_t count; // records in the ring
+    uint64_t first; // slot of the oldest record
+    uint32_t base_id; // lowest object id of the ring
+    uint32_t id_count;
+    uint64_t peak_live_bytes; // requested bytes, objects older than the ring not counted
+}replay_trace_t;
+
+typedef struct _replay_result{
+
+    double seconds;
+    uint64_t failures;
+    long base_rss_kb; // before the replay, the trace mapped and the object table touched
+    long peak_rss_kb;
+}replay_result_t;
+
+
+static uint32_t family_sizes[MM_TRACE_MAX_FAMILIES];
+
+
+static inline uint64_t replay_bytes(uint16_t family_id, uint32_t units){
+
+    return (uint64_t)units * (family_id < MM_TRACE_MAX_FAMILIES && family_sizes[family_id] ? family_sizes[family_id] : 1);
+}
+
+
+static vm_page_family_t* zalloc_families[MM_TRACE_MAX_FAMILIES];
+
+
+/**
+ * register a page family for every family of the trace, with the attributes it was recorded with
+ */
+static vm_bool_t zalloc_replay_init(const mm_trace_header_t* header, const char* lib_path){
+
+    (void)lib_path;
+    mm_init();
+
+    for(uint32_t i=0; i<MM_TRACE_MAX_FAMILIES; i++){
+
+        if(header->families[i].struct_size){
+
+            char name[MM_TRACE_NAME_LEN];
+
+            memcpy(name, header->families[i].struct_name, MM_TRACE_NAME_LEN);
+            name[MM_TRACE_NAME_LEN - 1] = '\0';
+            zalloc_families[i] = mm_instantiate_new_page_family(name, header->families[i].struct_size, header->families[i].flags);
+        }
+    }
+
+    return MM_TRUE;
+}
+
+
+static void* zalloc_replay_alloc(uint16_t family_id, uint32_t units, uint32_t alignment){
+
+    vm_page_family_t* family = family_id < MM_TRACE_MAX_FAMILIES ? zalloc_families[family_id] : NULL;
+
+    return alignment > 1 ? zalloc_family_aligned(family, (int)units, alignment) : zalloc_family(family, (int)units);
+}
+
+
+static void* zalloc_replay_realloc(void* ptr, uint16_t family_id, uint32_t units){
+
+    (void)family_id;
+    return zrealloc(ptr, (int)units);
+}
+
+
+static vm_bool_t glibc_replay_init(const mm_trace_header_t* header, const char* lib_path){
+
+    (void)header;
+    (void)lib_path;
+    return MM_TRUE;
+}
+
+
+/* zalloc() hands out zeroed objects, so the baseline is calloc() */
+static void* glibc_replay_alloc(uint16_t family_id, uint32_t units, uint32_t alignment){
+
+    uint64_t size = replay_bytes(family_id, units);
+    void* ptr = NULL;
+
+    if(alignment <= sizeof(void*)){
+
+        return calloc(1, size);
+    }
+
+    if(posix_memalign(&ptr, alignment, size)){
+
+        return NULL;
+    }
+
+    return memset(ptr, 0x0, size);
+}
+
+
+static void* glibc_replay_realloc(void* ptr, uint16_t family_id, uint32_t units){
+
+    return realloc(ptr, replay_bytes(family_id, units));
+}
+
+
+/* first and best fit of Task1, loaded from libmymalloc.so */
+static void* (*task1_malloc)(size_t size) = NULL;
+static void (*task1_free)(void* addr) = NULL;
+
+
+static vm_bool_t task1_replay_init(const char* lib_path, const char* malloc_name, const char* free_name){
+
+    void* lib = dlopen(lib_path, RTLD_NOW | RTLD_LOCAL);
+
+    if(lib == NULL){
+
+        fprintf(stderr, "%s\n", dlerror());
+        return MM_FALSE;
+    }
+
+    task1_malloc = (void* (*)(size_t))dlsym(lib, malloc_name);
+    task1_free = (void (*)(void*))dlsym(lib, free_name);
+
+    return task1_malloc && task1_free ? MM_TRUE : MM_FALSE;
+}
+
+
+static vm_bool_t ff_replay_init(const mm_trace_header_t* header, const char* lib_path){
+
+    (void)header;
+    return task1_replay_init(lib_path, "ff_malloc", "ff_free");
+}
+
+
+static vm_bool_t bf_replay_init(const mm_trace_header_t* header, const char* lib_path){
+
+    (void)header;
+    return task1_replay_init(lib_path, "bf_malloc", "bf_free");
+}
+
+
+/* Task1 has no alignment beyond its meta block */
+static void* task1_replay_alloc(uint16_t family_id, uint32_t units, uint32_t alignment){
+
+    (void)alignment;
+    return task1_malloc(replay_bytes(family_id, units));
+}
+
+
+static void task1_replay_free(void* ptr){
+
+    task1_free(ptr);
+}
+
+
+/* Task1 has no realloc, a resize always moves, the contents are not copied */
+static void* task1_replay_realloc(void* ptr, uint16_t family_id, uint32_t units){
+
+    void* new_ptr = task1_malloc(replay_bytes(family_id, units));
+
+    if(new_ptr){
+
+        task1_free(ptr);
+    }
+
+    return new_ptr;
+}
+
+
+static const replay_allocator_t allocators[] = {
+
+    {"zalloc", zalloc_replay_init, zalloc_replay_alloc, zfree, zalloc_replay_realloc},
+    {"glibc", glibc_replay_init, glibc_replay_alloc, free, glibc_replay_realloc},
+    {"ff", ff_replay_init, task1_replay_alloc, task1_replay_free, task1_replay_realloc},
+    {"bf", bf_replay_init, task1_replay_alloc, task1_replay_free, task1_replay_realloc},
+};
+
+
+static inline const mm_trace_record_t* replay_record(const replay_trace_t* trace, uint64_t i){
+
+    return &trace->header->records[(trace->first + i) % trace->header->capacity];
+}
+
+
+/**
+ * map a trace file and find the object id range and the peak of the requested bytes
+ */
+static vm_bool_t replay_trace_open(const char* path, replay_trace_t* trace){
+
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    const mm_trace_header_t* header = NULL;
+
+    if(fd == -1){
+
+        return MM_FALSE;
+    }
+
+    if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(mm_trace_header_t)){
+
+        close(fd);
+        return MM_FALSE;
+    }
+
+    header = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(header == MAP_FAILED || header->magic != MM_TRACE_MAGIC || header->version != MM_TRACE_VERSION ||
+       header->record_size != sizeof(mm_trace_record_t) || header->capacity == 0 ||
+       (size_t)st.st_size < sizeof(mm_trace_header_t) + (size_t)header->capacity * sizeof(mm_trace_record_t)){
+
+        return MM_FALSE;
+    }
+
+    memset(trace, 0x0, sizeof(replay_trace_t));
+    trace->header = header;
+    trace->count = header->head < header->capacity ? header->head : header->capacity;
+    trace->first = header->head < header->capacity ? 0 : header->head % header->capacity;
+
+    for(uint32_t i=0; i<MM_TRACE_MAX_FAMILIES; i++){
+
+        family_sizes[i] = header->families[i].struct_size;
+    }
+
+    uint32_t max_id = 0;
+
+    trace->base_id = UINT32_MAX;
+    for(uint64_t i=0; i<trace->count; i++){
+
+        const mm_trace_record_t* record = replay_record(trace, i);
+
+        trace->base_id = record->object_id < trace->base_id ? record->object_id : trace->base_id;
+        max_id = record->object_id > max_id ? record->object_id : max_id;
+    }
+
+    trace->id_count = trace->count ? max_id - trace->base_id + 1 : 0;
+
+    /* requested bytes of the objects the ring saw allocated */
+    uint64_t* sizes = calloc(trace->id_count + 1, sizeof(uint64_t));
+    uint64_t live_bytes = 0;
+
+    assert(sizes);
+
+    for(uint64_t i=0; i<trace->count; i++){
+
+        const mm_trace_record_t* record = replay_record(trace, i);
+        uint64_t* size = &sizes[record->object_id - trace->base_id];
+
+        if(record->op == MM_TRACE_ALLOC){
+
+            *size = replay_bytes(record->family_id, record->units);
+            live_bytes += *size;
+        }else if(record->op == MM_TRACE_REALLOC && *size){
+
+            live_bytes = live_bytes - *size + replay_bytes(record->family_id, record->units);
+            *size = replay_bytes(record->family_id, record->units);
+        }else if(record->op == MM_TRACE_FREE){
+
+            live_bytes -= *size;
+            *size = 0;
+        }
+
+        trace->peak_live_bytes = live_bytes > trace->peak_live_bytes ? live_bytes : trace->peak_live_bytes;
+    }
+
+    free(sizes);
+    return MM_TRUE;
+}
+
+
+/**
+ * re-execute the records, a free or a resize of an object allocated before the ring is skipped
+ */
+static uint64_t replay(const replay_trace_t* trace, const replay_allocator_t* allocator, void** objects){
+
+    uint64_t failures = 0;
+
+    for(uint64_t i=0; i<trace->count; i++){
+
+        const mm_trace_record_t* record = replay_record(trace, i);
+        void** object = &objects[record->object_id - trace->base_id];
+
+        switch(record->op){
+
+            case MM_TRACE_ALLOC:
+                if((*object = allocator->alloc(record->family_id, record->units, 1u << record->align_shift)) == NULL){
+
+                    failures++;
+                }
+                break;
+            case MM_TRACE_FREE:
+                if(*object){
+
+                    allocator->free(*object);
+                    *object = NULL;
+                }
+                break;
+            case MM_TRACE_REALLOC:
+                if(*object){
+
+                    void* new_object = allocator->realloc(*object, record->family_id, record->units);
+
+                    if(new_object){
+
+                        *object = new_object;
+                    }else{
+
+                        failures++;
+                    }
+                }
+                break;
+        }
+    }
+
+    return failures;
+}
+
+
+static long read_status_kb(const char* field){
+
+    char line[128];
+    long kb = -1;
+    FILE* status = fopen("/proc/self/status", "r");
+
+    if(status == NULL){
+
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), status)){
+
+        if(strncmp(line, field, strlen(field)) == 0){
+
+            kb = atol(line + strlen(field));
+            break;
+        }
+    }
+
+    fclose(status);
+    return kb;
+}
+
+
+/**
+ * set up the allocator and the object table in a new process, return the table or NULL
+ */
+static void** replay_prepare(const replay_trace_t* trace, const replay_allocator_t* allocator, const char* lib_path){
+
+    void** objects = NULL;
+
+    if(allocator->init(trace->header, lib_path) == MM_FALSE ||
+       (objects = calloc(trace->id_count + 1, sizeof(void*))) == NULL){
+
+        return NULL;
+    }
+
+    /* page the trace and the table in before anything is measured */
+    memset(objects, 0x0, (trace->id_count + 1) * sizeof(void*));
+    for(uint64_t i=0; i<trace->count; i++){
+
+        __atomic_load_n(&replay_record(trace, i)->op, __ATOMIC_RELAXED);
+    }
+
+    return objects;
+}
+
+
+/**
+ * time the replay in a child, the peak RSS is the VmHWM after a reset of the high water mark
+ */
+static vm_bool_t replay_timed(const replay_trace_t* trace, const replay_allocator_t* allocator, const char* lib_path, replay_result_t* result){
+
+    int fds[2];
+    int status = 0;
+    pid_t pid = 0;
+
+    if(pipe(fds) == -1 || (pid = fork()) == -1){
+
+        return MM_FALSE;
+    }
+
+    if(pid == 0){
+
+        replay_result_t child_result;
+        struct timespec start, end;
+        void** objects = replay_prepare(trace, allocator, lib_path);
+        int clear_refs = open("/proc/self/clear_refs", O_WRONLY);
+
+        close(fds[0]);
+        if(objects == NULL){
+
+            _exit(1);
+        }
+
+        /* "5" resets the peak RSS to the current RSS */
+        if(clear_refs != -1){
+
+            ssize_t reset = write(clear_refs, "5", 1);
+
+            (void)reset;
+            close(clear_refs);
+        }
+
+        child_result.base_rss_kb = read_status_kb("VmRSS:");
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        child_result.failures = replay(trace, allocator, objects);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        child_result.seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        child_result.peak_rss_kb = read_status_kb("VmHWM:");
+
+        _exit(write(fds[1], &child_result, sizeof(child_result)) == sizeof(child_result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    vm_bool_t ok = read(fds[0], result, sizeof(*result)) == sizeof(*result) ? MM_TRUE : MM_FALSE;
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? MM_TRUE : MM_FALSE;
+}
+
+
+/**
+ * count the system calls of the replay, the child stops itself once prepared and is traced from there
+ * on to its exit, return -1 when it can't be traced
+ */
+static long replay_syscalls(const replay_trace_t* trace, const replay_allocator_t* allocator, const char* lib_path){
+
+    struct ptrace_syscall_info info;
+    long syscalls = 0;
+    int status = 0;
+    pid_t pid = fork();
+
+    if(pid == -1){
+
+        return -1;
+    }
+
+    if(pid == 0){
+
+        void** objects = replay_prepare(trace, allocator, lib_path);
+
+        if(objects == NULL || ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1){
+
+            _exit(1);
+        }
+
+        raise(SIGSTOP);
+        replay(trace, allocator, objects);
+        _exit(0);
+    }
+
+    if(waitpid(pid, &status, 0) == -1 || !WIFSTOPPED(status) ||
+       ptrace(PTRACE_SETOPTIONS, pid, NULL, (void*)PTRACE_O_TRACESYSGOOD) == -1){
+
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+
+    while(ptrace(PTRACE_SYSCALL, pid, NULL, NULL) != -1 && waitpid(pid, &status, 0) != -1 && WIFSTOPPED(status)){
+
+        if(WSTOPSIG(status) == (SIGTRAP | 0x80) &&
+           ptrace(PTRACE_GET_SYSCALL_INFO, pid, (void*)sizeof(info), &info) > 0 && info.op == PTRACE_SYSCALL_INFO_ENTRY){
+
+            syscalls++;
+        }
+    }
+
+    waitpid(pid, &status, 0);
+
+    /* exit_group() of the child is not the replay's */
+    return syscalls ? syscalls - 1 : syscalls;
+}
+
+
+int main(int argc, char* argv[]){
+
+    replay_trace_t trace;
+    replay_result_t result;
+    const char* selected = argc > 2 ? argv[2] : "zalloc,glibc,ff,bf";
+    const char* lib_path = argc > 3 ? argv[3] : "../duke ECE 650/Task1/libmymalloc.so";
+
+    if(argc < 2){
+
+        fprintf(stderr, "usage: %s <trace file> [zalloc,glibc,ff,bf] [path of libmymalloc.so]\n", argv[0]);
+        return 1;
+    }
+
+    if(replay_trace_open(argv[1], &trace) == MM_FALSE){
+
+        fprintf(stderr, "%s is not a trace file\n", argv[1]);
+        return 1;
+    }
+
+    /* the replay of a tracing build must not trace itself */
+    unsetenv("MM_TRACE_FILE");
+
+    fflush(stdout);
+    printf("allocator,records,seconds,ops_per_sec,failures,syscalls,peak_live_kb,base_rss_kb,peak_rss_kb\n");
+
+    for(uint32_t a=0; a<sizeof(allocators)/sizeof(allocators[0]); a++){
+
+        size_t length = strlen(allocators[a].name);
+        const char* match = strstr(selected, allocators[a].name);
+
+        if(match == NULL || (match != selected && match[-1] != ',') || (match[length] != ',' && match[length] != '\0')){
+
+            continue;
+        }
+
+        fflush(stdout);
+        if(replay_timed(&trace, &allocators[a], lib_path, &result) == MM_FALSE){
+
+            fprintf(stderr, "%s: replay failed\n", allocators[a].name);
+            continue;
+        }
+
+        long syscalls = replay_syscalls(&trace, &allocators[a], lib_path);
+
+        printf("%s,%lu,%.4f,%.0f,%lu,%ld,%lu,%ld,%ld\n", allocators[a].name, (unsigned long)trace.count, result.seconds,
+                result.seconds > 0 ? trace.count / result.seconds : 0.0, (unsigned long)result.failures, syscalls,
+                (unsigned long)(trace.peak_live_bytes / 1024), result.base_rss_kb, result.peak_rss_kb);
+    }
+
+    return 0;
+}
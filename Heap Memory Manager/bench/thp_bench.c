@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include "uapi_mm.h"
+
+/*
+ * pointer chasing over a shuffled student_t list, once from normal VM pages and once from
+ * MM_FAMILY_HUGEPAGE pages, reporting time and dTLB load misses of the traversals
+ *
+ * usage: thp_bench [nodes] [rounds]
+ */
+
+typedef struct _student{
+
+    char name[MAX_NAME_LEN];
+    uint32_t rollno;
+    uint32_t marks_phys;
+    uint32_t marks_chem;
+    uint32_t marks_maths;
+    struct _student* next;
+}student_t;
+
+/* same layout, registered as a huge page family */
+typedef student_t hot_student_t;
+
+
+/**
+ * open a counter of the dTLB load misses of this thread, -1 if perf events are not available
+ */
+static int perf_open_dtlb_misses(void){
+
+    struct perf_event_attr attr;
+
+    memset(&attr, 0x0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+
+/**
+ * kB of this process' anonymous memory backed by transparent huge pages, 0 if unknown
+ */
+static unsigned long anon_huge_kb(void){
+
+    char line[256];
+    unsigned long kb = 0;
+    FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+
+    if(fp == NULL){
+
+        return 0;
+    }
+
+    while(fgets(line, sizeof(line), fp)){
+
+        if(sscanf(line, "AnonHugePages: %lu kB", &kb) == 1){
+
+            break;
+        }
+    }
+
+    fclose(fp);
+    return kb;
+}
+
+
+static double now_sec(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * allocate 'nodes' students from the family and link them in a random order
+ */
+static student_t* build_list(vm_page_family_t* family, student_t** nodes, uint32_t count){
+
+    for(uint32_t i=0; i<count; i++){
+
+        nodes[i] = zalloc_family(family, 1);
+        assert(nodes[i]);
+        nodes[i]->rollno = i;
+    }
+
+    srand(650);
+    for(uint32_t i=count-1; i>0; i--){
+
+        uint32_t j = (uint32_t)rand() % (i + 1);
+        student_t* tmp = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = tmp;
+    }
+
+    for(uint32_t i=0; i+1<count; i++){
+
+        nodes[i]->next = nodes[i+1];
+    }
+    nodes[count-1]->next = NULL;
+
+    return nodes[0];
+}
+
+
+static void run(const char* label, vm_page_family_t* family, student_t** nodes, uint32_t count, uint32_t rounds){
+
+    student_t* head = build_list(family, nodes, count);
+    int fd = perf_open_dtlb_misses();
+    uint64_t misses = 0;
+    volatile uint64_t sum = 0;
+
+    if(fd >= 0){
+
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    double start = now_sec();
+
+    for(uint32_t r=0; r<rounds; r++){
+
+        for(student_t* cur = head; cur; cur = cur->next){
+
+            sum += cur->rollno;
+        }
+    }
+
+    double elapsed = now_sec() - start;
+
+    if(fd >= 0){
+
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(fd, &misses, sizeof(misses)) != sizeof(misses)){
+
+            misses = 0;
+        }
+        close(fd);
+    }
+
+    printf("%s,%u,%u,%lu,%.3f,%.2f,", label, count, rounds, anon_huge_kb(), elapsed, elapsed * 1e9 / ((double)count * rounds));
+    if(fd >= 0){
+
+        printf("%lu,%.4f\n", (unsigned long)misses, (double)misses / ((double)count * rounds));
+    }else{
+
+        printf("n/a,n/a\n");
+    }
+
+    for(uint32_t i=0; i<count; i++){
+
+        zfree(nodes[i]);
+    }
+}
+
+
+int main(int argc, char* argv[]){
+
+    uint32_t count = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+    uint32_t rounds = argc > 2 ? (uint32_t)atoi(argv[2]) : 5;
+
+    if(count == 0 || rounds == 0){
+
+        return 1;
+    }
+
+    mm_init();
+
+    vm_page_family_t* student_family = MM_REG_STRUCT(student_t);
+    vm_page_family_t* hot_student_family = MM_REG_STRUCT_ATTR(hot_student_t, MM_FAMILY_HUGEPAGE);
+    student_t** nodes = malloc(sizeof(student_t*) * count);
+
+    if(nodes == NULL){
+
+        return 1;
+    }
+
+    printf("pages,nodes,rounds,anon_huge_kb,seconds,ns_per_node,dtlb_load_misses,misses_per_node\n");
+    run("4k", student_family, nodes, count, rounds);
+    mm_flush_page_cache();
+    run("thp", hot_student_family, nodes, count, rounds);
+
+    free(nodes);
+    return 0;
+}
@@ -1,12 +1,57 @@
 #ifndef __MM_H_
 #define __MM_H_
 
+/* 
+ * concurrent mode: every thread allocates from its own heap of page families,
+ * only heap creation and registration touch shared state
+ */
+#ifndef MM_THREAD_SAFE
+#define MM_THREAD_SAFE  0
+#endif
+
+/*
+ * instrumentation build: per page family log2 bucketed latency histograms of zalloc, zfree,
+ * VM page acquire and release plus split branch counters, see mm_get_latency_stats()
+ */
+#ifndef MM_LATENCY_HIST
+#define MM_LATENCY_HIST 0
+#endif
+
+/*
+ * allocation tracing: every zalloc, zfree and zrealloc appends a record to a memory-mapped ring file,
+ * see mm_trace_start() and mm_trace.h. mm_init() starts a trace into $MM_TRACE_FILE when it is set
+ */
+#ifndef MM_TRACE
+#define MM_TRACE 0
+#endif
+#define MM_TRACE_DEFAULT_RECORDS    (1u << 20)
+
+/*
+ * per family quotas: limits on the pages and data bytes a registered family holds over all threads,
+ * plus their high water marks, see mm_set_family_quota()
+ */
+#ifndef MM_QUOTAS
+#define MM_QUOTAS 0
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
 #include <memory.h>
 #include <unistd.h>  // get page size from kernel (getpagesize())
 #include <sys/mman.h> // mmap(), munmap()
 #include <assert.h>
+#if MM_THREAD_SAFE
+#include <pthread.h>
+#endif
+#if MM_LATENCY_HIST && !defined(__x86_64__) && !defined(__i386__)
+#include <time.h> // clock_gettime()
+#endif
+#if MM_TRACE
+#include <stdlib.h> // getenv()
+#include <fcntl.h> // open()
+#include <time.h> // clock_gettime()
+#include "mm_trace.h"
+#endif
 #include "glthread.h"
 #include "css.h"
 
@@ -15,24 +60,121 @@
 #define MM_DEBUG        DEBUG_OFF
 #define MAX_NAME_LEN    32
 
-/* Free VM Page size that can be used */
-#define MAX_FAMILY_PER_PAGE (SYSTEM_PAGE_SIZE - sizeof(vm_page_family_list_t*)) / sizeof(vm_page_family_t)
+/* free block management policy of a page family */
+#define MM_BEST_FIT_PQ          0   // sorted glthread priority queue (linear insertion)
+#define MM_SIZE_CLASS_BINS      1   // power-of-two size class bins + non-empty bin bitmap
+#ifndef MM_FREE_BLK_POLICY
+#define MM_FREE_BLK_POLICY      MM_SIZE_CLASS_BINS
+#endif
+
+#define MM_MAX_FREE_BINS        32  // one bin per power of two of a uint32_t size
+#define MM_BIN_SCAN_LIMIT       8   // blocks checked in the request's own bin before giving up
+
+/*
+ * deferred coalescing: freed blocks of up to MM_QUICK_LIST_MAX_SIZE data bytes wait uncoalesced on
+ * per size LIFO quick lists of their page family, 0 frees every block eagerly
+ */
+#ifndef MM_QUICK_LIST_MAX_SIZE
+#define MM_QUICK_LIST_MAX_SIZE  256
+#endif
+#define MM_QUICK_LIST_DEPTH     32  // a quick list that would get longer is coalesced first
+
+/* empty VM page retention: default high/low water marks of a page family cache and the global cache */
+#define MM_FAMILY_PAGE_CACHE_HIGH   4
+#define MM_FAMILY_PAGE_CACHE_LOW    2
+#define MM_GLOBAL_PAGE_CACHE_HIGH   64
+#define MM_GLOBAL_PAGE_CACHE_LOW    32
+
+/*
+ * trim: the memory of free region pages that were used goes back to the kernel with MM_TRIM_ADVICE,
+ * MADV_DONTNEED pages read back as zero, MADV_FREE pages are only reclaimed under memory pressure.
+ * With MM_AUTO_TRIM_PAGES set a region is trimmed once it holds that many used free pages, see mm_trim()
+ */
+#ifndef MM_TRIM_ADVICE
+#define MM_TRIM_ADVICE              MADV_DONTNEED
+#endif
+#ifndef MM_AUTO_TRIM_PAGES
+#define MM_AUTO_TRIM_PAGES          0
+#endif
+
+#if MM_LATENCY_HIST
+/* bucket i counts samples of [2^i, 2^(i+1)) ticks, ticks are TSC cycles on x86 and nanoseconds elsewhere */
+#define MM_HIST_BUCKETS             32
+
+typedef enum{
+
+    MM_HIST_ZALLOC,
+    MM_HIST_ZFREE,
+    MM_HIST_PAGE_ACQUIRE,
+    MM_HIST_PAGE_RELEASE,
+    MM_HIST_OPS
+}mm_hist_op_t;
+
+/* branches of mm_split_free_data_block_for_allocation() */
+typedef enum{
+
+    MM_SPLIT_NONE,
+    MM_SPLIT_SOFT_IF,
+    MM_SPLIT_HARD_IF,
+    MM_SPLIT_FULL,
+    MM_SPLIT_KINDS
+}mm_split_kind_t;
+#endif
+
+/* page family attributes, given at registration */
+#define MM_FAMILY_HUGEPAGE          (1u << 0)   // back the VM pages with transparent huge page regions
+#define MM_FAMILY_SLAB              (1u << 1)   // single unit objects live header-free in bitmap slab pages
+#define MM_FAMILY_ALIGN(alignment)  ((uint32_t)__builtin_ctz(alignment) << MM_FAMILY_ALIGN_SHIFT) // power of 2 object alignment
+
+/* the alignment attribute is kept as log2 in the flags, no attribute means no guarantee */
+#define MM_FAMILY_ALIGN_SHIFT       8
+#define MM_FAMILY_ALIGN_MASK        (0xfu << MM_FAMILY_ALIGN_SHIFT)
+#define MM_FAMILY_ALIGNMENT(vm_page_family_ptr) \
+            (1u << (((vm_page_family_ptr)->flags & MM_FAMILY_ALIGN_MASK) >> MM_FAMILY_ALIGN_SHIFT))
+#define MM_MAX_ALIGNMENT            2048    // an aligned object still starts in the first system page of its VM page
+#define MM_ALIGN_UP(value, alignment) (((value) + (alignment) - 1) & ~((uintptr_t)(alignment) - 1))
+
+/* what the data area of a VM page holds */
+#define MM_VM_PAGE_BLOCKS           0   // meta blocks, the default
+#define MM_VM_PAGE_SLAB             1   // occupancy bitmap followed by fixed size slots
+#define MM_VM_PAGE_ARENA            2   // bump allocated objects of an arena, freed with the arena only
+
+/* single system page VM pages are carved out of reserved, MM_REGION_SIZE aligned regions */
+#define MM_REGION_SIZE              (2 * 1024 * 1024)
+#define MM_REGION_MAP_WORDS         (MM_REGION_SIZE / 4096 / 64)
+
+/* two level radix map from the address of a VM page to its page family, covers 48 bit addresses */
+#define MM_PAGE_MAP_SHIFT           12
+#define MM_PAGE_MAP_LEAF_BITS       20
+#define MM_PAGE_MAP_ROOT_BITS       (48 - MM_PAGE_MAP_SHIFT - MM_PAGE_MAP_LEAF_BITS)
+
+/* thread local page family table of a heap: chunks of family pointers indexed by family_id */
+#define MM_HEAP_FAMILIES_PER_CHUNK  512
+#define MM_HEAP_MAX_FAMILY_CHUNKS   128
+
+/*
+ * registry of page families: a dense array indexed by family_id, kept in chunks that double in size
+ * so that a registered family never moves, chunk k holds MM_FAMILY_CHUNK_BASE << k families
+ */
+#define MM_FAMILY_CHUNK_BASE_SHIFT  4
+#define MM_FAMILY_CHUNK_BASE        (1u << MM_FAMILY_CHUNK_BASE_SHIFT)
+#define MM_FAMILY_CHUNKS            (32 - MM_FAMILY_CHUNK_BASE_SHIFT)
 
 /* the offset of a particular field_name */ 
 #define offset_of(container_structure, field_name) (size_t)&(((container_structure*)0)->field_name)
 #define META_SIZE sizeof(meta_blk_t)                                  
-
-/* Iterative macro for searching the VM Page from bottom to top */
-#define ITERATE_PAGE_FAMILIES_BEGIN(vm_page_for_families_ptr, curr)          \
-        {                                                                    \
-        curr = (vm_page_family_t*)&vm_page_for_families_ptr->vm_page[0];     \
-        uint32_t max = MAX_FAMILY_PER_PAGE;                                  \
-        for(uint32_t i=0; i<max; i++, curr++){                               \
-            if(curr->struct_size == 0){                                      \
-                break;                                                       \
-            }                                                                
-        
-#define ITERATE_PAGE_FAMILIES_END }}
+/* data blocks start on this boundary, their sizes are rounded up to it */
+#define MM_DATA_BLK_ALIGN 8
+/* quick list i holds blocks of i * MM_DATA_BLK_ALIGN data bytes, linked through their first data word */
+#define MM_QUICK_LISTS (MM_QUICK_LIST_MAX_SIZE / MM_DATA_BLK_ALIGN + 1)
+#define MM_QUICK_LIST_NEXT(meta_blk_ptr) (*(meta_blk_t**)((meta_blk_t*)(meta_blk_ptr) + 1))
+/* a free block keeps its free block list glue in its data area, so no data block is smaller than that */
+#define MM_MIN_DATA_BLK_SIZE sizeof(glthread_node_t)
+#if MM_THREAD_SAFE
+#define MM_MIN_SLAB_SLOT_SIZE (2 * sizeof(void*))
+#else
+#define MM_MIN_SLAB_SLOT_SIZE sizeof(void*)
+#endif
 
 #define ITERATE_VM_PAGE_BEGIN(vm_page_family_ptr, cur)  \
             {                                           \
@@ -53,37 +195,99 @@
             meta_blk_t* ptr = NULL;                                                                     \
             glthread_node_t* _node = (glthread_ptr)->right;                                             \
             for(; _node; _node = _node->right){                                                         \
-                ptr = (meta_blk_t*)((uint8_t*)(_node) - offsetof(meta_blk_t, priority_thread_glue));    
+                ptr = glthread_to_meta_block(_node);                                                    
 
 #define PQ_ITERATE_END   }}
 
-#define MM_GET_PAGE_FROM_META_BLOCK(meta_blk_ptr) (void*)((uint8_t*)meta_blk_ptr - meta_blk_ptr->offset)
+/* size class of a free block: floor(log2(size)) */
+#define MM_SIZE_TO_BIN(size)    ((size) ? 31 - __builtin_clz(size) : 0)
+
+/* system page size, set by mm_init(), the page and block macros below can be used in any translation unit */
+extern size_t mm_system_page_size;
+#define SYSTEM_PAGE_SIZE mm_system_page_size
+
+/* every VM page starts on a system page and every object starts in the first system page of its VM page */
+#define MM_GET_PAGE_FROM_ADDR(addr) ((vm_page_t*)((uintptr_t)(addr) & ~((uintptr_t)SYSTEM_PAGE_SIZE - 1)))
+#define MM_GET_PAGE_FROM_META_BLOCK(meta_blk_ptr) MM_GET_PAGE_FROM_ADDR(meta_blk_ptr)
+/* offset of a meta block from the start of its VM page */
+#define MM_META_BLK_OFFSET(meta_blk_ptr) ((uint32_t)((uintptr_t)(meta_blk_ptr) & ((uintptr_t)SYSTEM_PAGE_SIZE - 1)))
+#define MM_SLAB_FREE_MAP(vm_page_ptr) ((uint64_t*)(vm_page_ptr)->page_data_blk)
 #define GET_DATA_BLK(meta_blk_ptr) (meta_blk_t*)meta_blk_ptr + 1
 #define GET_META_BLK(meta_blk_ptr) (meta_blk_t*)meta_blk_ptr - 1
-#define NEXT_META_BLOCK(meta_blk_ptr) (((meta_blk_t*)meta_blk_ptr)->next_blk)
-#define PREV_META_BLOCK(meta_blk_ptr) (((meta_blk_t*)meta_blk_ptr)->pre_blk)
+
+/* the free state of a meta block is the top bit of its size word, the next bit marks an allocated
+ * block that waits on a quick list, freed by the application but not coalesced yet */
+#define MM_META_BLK_FREE        (1u << 31)
+#define MM_META_BLK_QUICK       (1u << 30)
+#define MM_META_BLK_MAX_SIZE    (MM_META_BLK_QUICK - 1)
+#define MM_META_BLK_SIZE(meta_blk_ptr) ((meta_blk_ptr)->size_and_free & MM_META_BLK_MAX_SIZE)
+#define MM_META_BLK_IS_FREE(meta_blk_ptr) (((meta_blk_ptr)->size_and_free & MM_META_BLK_FREE) ? MM_TRUE : MM_FALSE)
+#define MM_META_BLK_IS_QUICK(meta_blk_ptr) (((meta_blk_ptr)->size_and_free & MM_META_BLK_QUICK) ? MM_TRUE : MM_FALSE)
+#define MM_META_BLK_SET_SIZE(meta_blk_ptr, size)  \
+    (meta_blk_ptr)->size_and_free = ((meta_blk_ptr)->size_and_free & MM_META_BLK_FREE) | (uint32_t)(size)
+#define MM_META_BLK_SET_FREE(meta_blk_ptr, free)  \
+    (meta_blk_ptr)->size_and_free = MM_META_BLK_SIZE(meta_blk_ptr) | ((free) ? MM_META_BLK_FREE : 0)
+#define MM_META_BLK_SET_QUICK(meta_blk_ptr, quick)  \
+    (meta_blk_ptr)->size_and_free = MM_META_BLK_SIZE(meta_blk_ptr) | ((quick) ? MM_META_BLK_QUICK : 0)
+/* the free block list glue of a free block */
+#define MM_META_BLK_GLUE(meta_blk_ptr) ((glthread_node_t*)((meta_blk_t*)(meta_blk_ptr) + 1))
+
+/* neighbour links are offsets from the start of the VM page, 0 marks no neighbour */
+#define MM_META_BLK_AT(meta_blk_ptr, blk_offset) \
+            ((meta_blk_t*)((uint8_t*)MM_GET_PAGE_FROM_ADDR(meta_blk_ptr) + (blk_offset)))
+#define NEXT_META_BLOCK(meta_blk_ptr) \
+            (((meta_blk_t*)(meta_blk_ptr))->next_offset ? MM_META_BLK_AT((meta_blk_t*)(meta_blk_ptr), ((meta_blk_t*)(meta_blk_ptr))->next_offset) : NULL)
+#define PREV_META_BLOCK(meta_blk_ptr) \
+            (((meta_blk_t*)(meta_blk_ptr))->pre_offset ? MM_META_BLK_AT((meta_blk_t*)(meta_blk_ptr), ((meta_blk_t*)(meta_blk_ptr))->pre_offset) : NULL)
 #define NEXT_META_BLOCK_BY_SIZE(meta_blk_ptr)   \
-            (meta_blk_t*)((uint8_t*)((meta_blk_t*)meta_blk_ptr + 1) + meta_blk_ptr->data_blk_size)
+            (meta_blk_t*)((uint8_t*)((meta_blk_t*)meta_blk_ptr + 1) + MM_META_BLK_SIZE(meta_blk_ptr))
 
 #define MM_BIND_BLKS_FOR_ALLOCATION(allocated_meta_block, free_meta_block)      \
-    free_meta_block->pre_blk = allocated_meta_block;                            \
-    free_meta_block->next_blk = allocated_meta_block->next_blk;                 \
-    allocated_meta_block->next_blk = free_meta_block;                           \
-    if (free_meta_block->next_blk)                                              \
-        free_meta_block->next_blk->pre_blk = free_meta_block   
+    free_meta_block->pre_offset = MM_META_BLK_OFFSET(allocated_meta_block);     \
+    free_meta_block->next_offset = allocated_meta_block->next_offset;           \
+    allocated_meta_block->next_offset = MM_META_BLK_OFFSET(free_meta_block);    \
+    if (free_meta_block->next_offset)                                           \
+        NEXT_META_BLOCK(free_meta_block)->pre_offset = MM_META_BLK_OFFSET(free_meta_block)
 
 #define MM_BIND_BLKS_FOR_DEALLOCATION(freed_meta_block_top, freed_meta_block_down)  \
-    freed_meta_block_top->next_blk = freed_meta_block_down->next_blk;               \
-    if(freed_meta_block_down->next_blk)                                             \
-    freed_meta_block_down->next_blk->pre_blk = freed_meta_block_top
+    freed_meta_block_top->next_offset = freed_meta_block_down->next_offset;         \
+    if(freed_meta_block_down->next_offset)                                          \
+    NEXT_META_BLOCK(freed_meta_block_down)->pre_offset = MM_META_BLK_OFFSET(freed_meta_block_top)
+
 
+/* a VM page that spans more than one system page holds a single large object */
+#define MM_IS_LARGE_VM_PAGE(vm_page_t_ptr) ((vm_page_t_ptr)->page_units > 1)
+
+/* everything below end_ptr may have been written: move the clean offset of the VM page up */
+#define MM_MARK_VM_PAGE_DIRTY(vm_page_t_ptr, end_ptr)                                       \
+    {                                                                                       \
+        uint32_t _dirty_end = (uint32_t)((uint8_t*)(end_ptr) - (uint8_t*)(vm_page_t_ptr));  \
+        if(_dirty_end > (vm_page_t_ptr)->clean_offset)                                      \
+            (vm_page_t_ptr)->clean_offset = _dirty_end;                                     \
+    }
 
 #define MARK_VM_PAGE_EMPTY(vm_page_t_ptr)              \
-            vm_page_t_ptr->meta_blk.next_blk = NULL;   \
-            vm_page_t_ptr->meta_blk.pre_blk = NULL;    \
-            vm_page_t_ptr->meta_blk.is_free = MM_TRUE
+            vm_page_t_ptr->meta_blk.next_offset = 0;   \
+            vm_page_t_ptr->meta_blk.pre_offset = 0;    \
+            MM_META_BLK_SET_FREE(&vm_page_t_ptr->meta_blk, MM_TRUE)
+
+/* the page family of struct_name is looked up once per call site and cached */
+#define ZMALLOC(struct_name, units)                                             \
+    ({                                                                          \
+        static vm_page_family_t* _zmalloc_family = NULL;                        \
+        if(_zmalloc_family == NULL)                                             \
+            _zmalloc_family = lookup_page_family_by_name(#struct_name);         \
+        zalloc_family(_zmalloc_family, units);                                  \
+    })
+/* like ZMALLOC but the memory is not zeroed, for callers that initialize every field */
+#define ZMALLOC_NOZERO(struct_name, units)                                      \
+    ({                                                                          \
+        static vm_page_family_t* _zmalloc_family = NULL;                        \
+        if(_zmalloc_family == NULL)                                             \
+            _zmalloc_family = lookup_page_family_by_name(#struct_name);         \
+        zalloc_family_nozero(_zmalloc_family, units);                           \
+    })
 
-#define ZMALLOC(struct_name, units) zalloc(#struct_name, units)
 #define ZFREE(addr) zfree(addr);
 
 typedef enum{
@@ -92,50 +296,208 @@ typedef enum{
     MM_TRUE
 }vm_bool_t;
 
+/**
+ * every block lives inside the first system page of its VM page, so the block links are page relative
+ * offsets and the VM page of a block is found by masking its address, a free block links into the
+ * free block list through MM_META_BLK_GLUE() in its data area
+ */ 
 typedef struct _meta_blk{
 
-    uint32_t data_blk_size;
-    uint32_t offset;
-    vm_bool_t is_free;
-    glthread_node_t priority_thread_glue;
-    struct _meta_blk* pre_blk;
-    struct _meta_blk* next_blk;
+    uint32_t size_and_free; // data block size | MM_META_BLK_FREE | MM_META_BLK_QUICK
+    uint16_t pre_offset;
+    uint16_t next_offset;
 }meta_blk_t;
 
 struct _vm_page_family;
+struct _mm_heap;
 
 typedef struct _vm_page{
 
     struct _vm_page* next_page;
     struct _vm_page* pre_page;
     struct _vm_page_family* page_family; // back pointer
+    uint32_t page_units; // number of system pages covered by this VM page
+    uint32_t clean_offset; // bytes from this offset to the end of the VM page are known to be zero
+    uint32_t page_type; // MM_VM_PAGE_BLOCKS, MM_VM_PAGE_SLAB or MM_VM_PAGE_ARENA
+    union{
+
+        uint32_t slab_free_count; // free slots of a slab page
+        uint32_t large_obj_offset; // offset of the object of a large VM page from the page start
+        struct{
+
+            uint16_t live_blocks; // blocks of a meta block page held by the application
+            uint16_t quick_blocks; // blocks of a meta block page waiting on the quick lists
+        };
+    };
+    glthread_node_t slab_glue; // links a slab page with free slots into slab_partial_pages
     meta_blk_t meta_blk;
     uint8_t page_data_blk[0];
 }vm_page_t;
 
+/**
+ * counters of a page family, kept up to date on every allocation and free by the thread that owns the family
+ */ 
+typedef struct _mm_family_counters{
+
+    uint64_t pages; // system pages in use, retained empty pages are not counted
+    uint64_t allocated_blocks;
+    uint64_t free_blocks; // free meta blocks and free slab slots
+    uint64_t bytes_in_use; // data bytes of the allocated blocks
+    uint64_t hard_if_bytes; // bytes after allocated blocks that no block can use
+    uint64_t soft_if_bytes; // free blocks, meta block included, too small for one struct
+}mm_family_counters_t;
+
+#if MM_QUOTAS
+/**
+ * limits and usage of a registered family, shared by its thread local copies and updated atomically,
+ * pages are checked when a VM page is acquired and bytes when an object is allocated
+ */ 
+typedef struct _mm_family_quota{
+
+    uint64_t max_pages; // 0 for no limit
+    uint64_t max_bytes; // data bytes, 0 for no limit
+    uint64_t pages; // system pages in use
+    uint64_t bytes; // data bytes of the allocated blocks
+    uint64_t peak_pages;
+    uint64_t peak_bytes;
+    uint64_t failures; // allocations refused for the quota
+}mm_family_quota_t;
+#endif
+
+#if MM_LATENCY_HIST
+typedef struct _mm_latency_stats{
+
+    uint64_t hist[MM_HIST_OPS][MM_HIST_BUCKETS];
+    uint64_t splits[MM_SPLIT_KINDS];
+}mm_latency_stats_t;
+#endif
+
 typedef struct _vm_page_family{
 
     char struct_name[MAX_NAME_LEN];
+    uint32_t name_hash;
     uint32_t struct_size;
+    uint32_t flags; // MM_FAMILY_* attributes
+    uint32_t family_id; // registration order
+    struct _mm_heap* heap; // owner heap of a thread local family, NULL for a registered family
+    struct _vm_page_family* reg_family; // registered family this one is a copy of, itself if registered
     vm_page_t* first_page;
+    vm_page_t* cached_pages; // empty VM pages kept mapped for reuse, linked through next_page
+    uint32_t cached_page_count;
+    uint32_t page_cache_high; // spill cached pages down to page_cache_low once above page_cache_high
+    uint32_t page_cache_low;
+    uint32_t slab_slot_size; // MM_FAMILY_SLAB geometry: slots are packed from slab_obj_offset on
+    uint32_t slab_obj_count;
+    uint32_t slab_obj_offset;
+    glthread_node_t slab_partial_pages; // slab pages with free slots
+    mm_family_counters_t counters;
+#if MM_QUOTAS
+    mm_family_quota_t quota; // used in the registered family only
+    uint64_t quota_reserved; // bytes the allocation in flight reserved and has not charged yet
+#endif
+#if MM_LATENCY_HIST
+    mm_latency_stats_t latency;
+#endif
+#if MM_QUICK_LIST_MAX_SIZE
+    meta_blk_t* quick_lists[MM_QUICK_LISTS];
+    uint16_t quick_counts[MM_QUICK_LISTS];
+    uint32_t quick_block_count;
+#endif
+#if MM_FREE_BLK_POLICY == MM_SIZE_CLASS_BINS
+    uint32_t free_bins_bitmap; // bit i is set when free_bins[i] is not empty
+    uint32_t free_bins_stale; // bit i is set when the largest block left free_bins[i], free_bins_largest[i] is an upper bound
+    uint32_t free_bins_largest[MM_MAX_FREE_BINS]; // size of the largest block of each bin
+    glthread_node_t free_bins[MM_MAX_FREE_BINS];
+#else
     glthread_node_t free_blks_pq; // priority queue
+#endif
 }vm_page_family_t;
 
-typedef struct _vm_page_family_list{
+/* 
+ * header of a reserved region, kept in its first system page, a region is found from any of its
+ * pages by masking the address with MM_REGION_SIZE
+ */
+typedef struct _mm_region{
+
+    struct _mm_region* next; // regions that still have free pages
+    struct _mm_region* pre;
+    vm_bool_t huge; // madvise(MADV_HUGEPAGE)'d region of MM_FAMILY_HUGEPAGE families
+    uint32_t page_count; // pages that can be handed out, the header page excluded
+    uint32_t free_page_count;
+    uint32_t clean_page_index; // pages from this index on were never handed out since mmap
+    uint32_t released_page_count;
+    uint64_t free_map[MM_REGION_MAP_WORDS]; // bit i is set when page i of the region is free
+    uint64_t released_map[MM_REGION_MAP_WORDS]; // bit i is set when free page i was given back to the kernel
+}mm_region_t;
+
+#define MM_GET_REGION_FROM_PAGE(vm_page_ptr) \
+            ((mm_region_t*)((uintptr_t)(vm_page_ptr) & ~((uintptr_t)MM_REGION_SIZE - 1)))
+
+/* snapshot of a registered page family, see mm_get_stats() */
+typedef struct _mm_family_stats{
+
+    char struct_name[MAX_NAME_LEN];
+    uint32_t struct_size;
+    mm_family_counters_t counters; // summed over the heaps of all threads in concurrent mode
+    uint64_t largest_free_block; // data bytes
+#if MM_QUOTAS
+    mm_family_quota_t quota;
+#endif
+}mm_family_stats_t;
+
+typedef struct _mm_stats{
+
+    uint32_t family_count; // registered page families, may be more than the entries filled in
+    uint32_t region_count;
+    uint32_t global_cached_pages;
+    uint32_t released_pages; // free region pages whose memory was given back to the kernel by a trim
+}mm_stats_t;
+
+/**
+ * objects of any page family bump allocated from VM pages the arena owns, they are not freed
+ * one by one but all at once by mm_arena_reset()/mm_arena_destroy(). An arena is used by one thread
+ */ 
+typedef struct _mm_arena{
+
+    vm_page_family_t page_owner; // never registered, its page list holds the VM pages of the arena
+    vm_page_t* bump_page; // single system page VM page objects are carved from
+    uint8_t* bump_cursor;
+    uint8_t* bump_limit;
+}mm_arena_t;
+
+#if MM_THREAD_SAFE
+/* 
+ * per thread heap: thread local copies of the registered page families that own their
+ * VM pages, plus the blocks other threads have freed into them
+ */
+typedef struct _mm_heap{
+
+    struct _mm_heap* next;
+    vm_bool_t in_use; // owned by a live thread
+    void* remote_free_list; // lock free stack of objects freed by other threads, see mm_heap_push_remote_frees()
+    uint8_t* family_cursor; // carving area for new thread local families
+    uint32_t family_space;
+    vm_page_family_t** families[MM_HEAP_MAX_FAMILY_CHUNKS];
+}mm_heap_t;
+#endif
+
+GLTHREAD_TO_STRUCT(glthread_to_slab_page, vm_page_t, slab_glue, glthread_ptr);
 
-    struct _vm_page_family_list* next;
-    vm_page_family_t vm_page[0];
-}vm_page_family_list_t;
+static inline meta_blk_t* glthread_to_meta_block(glthread_node_t* glthread_ptr){
 
-GLTHREAD_TO_STRUCT(glthread_to_meta_block, meta_blk_t, priority_thread_glue, glthread_ptr);
+    return (meta_blk_t*)glthread_ptr - 1;
+}
 
 void mm_init(void);
 void mm_debug_fn(void);
-void mm_instantiate_new_page_family(char* struct_name, uint32_t struct_size);
+vm_page_family_t* mm_instantiate_new_page_family(char* struct_name, uint32_t struct_size, uint32_t flags);
 void mm_print_registered_page_families();
 vm_page_family_t* lookup_page_family_by_name(char *struct_name);
 vm_bool_t mm_vm_page_is_empty(vm_page_t* vm_page);
-vm_page_t* allocate_vm_page(vm_page_family_t* vm_page_family);
+vm_page_t* allocate_vm_page(vm_page_family_t* vm_page_family, uint32_t units);
 void mm_page_delete_and_free(vm_page_t* vm_page);
+void mm_set_family_page_cache(vm_page_family_t* vm_page_family, uint32_t high_water, uint32_t low_water);
+void mm_set_global_page_cache(uint32_t high_water, uint32_t low_water);
+void mm_flush_page_cache(void);
 
 #endif /* __MM_H_ */
\ No newline at end of file
@@ -0,0 +1,201 @@
+#ifndef __MM_TRACE_H_
+#define __MM_TRACE_H_
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+/*
+ * allocation trace file: a header followed by a ring of 'capacity' fixed size records, record i of
+ * the stream is slot i % capacity, so once 'head' passes 'capacity' the file holds the last
+ * 'capacity' records. Sizes are in structures of the family, a byte allocator records 1 byte families
+ */
+#define MM_TRACE_MAGIC          0x52544d4d  // "MMTR"
+#define MM_TRACE_VERSION        1
+#define MM_TRACE_MAX_FAMILIES   1024
+#define MM_TRACE_NAME_LEN       32
+
+typedef enum{
+
+    MM_TRACE_ALLOC,     // object_id is new, units structures of family_id
+    MM_TRACE_FREE,      // object_id goes away
+    MM_TRACE_REALLOC    // object_id is resized to units structures, it may have moved
+}mm_trace_op_t;
+
+typedef struct _mm_trace_record{
+
+    uint8_t op; // mm_trace_op_t
+    uint8_t align_shift; // the object was allocated on a 1 << align_shift boundary
+    uint16_t family_id;
+    uint32_t units;
+    uint32_t object_id; // allocation order
+    uint32_t delta_ns; // since the previous record, saturated
+}mm_trace_record_t;
+
+typedef struct _mm_trace_family{
+
+    uint32_t struct_size; // 0 while the family has no record
+    uint32_t flags; // registration attributes, MM_FAMILY_* of the Heap Memory Manager
+    char struct_name[MM_TRACE_NAME_LEN];
+}mm_trace_family_t;
+
+typedef struct _mm_trace_header{
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity; // records in the ring
+    uint32_t reserved;
+    uint64_t head; // records written so far
+    mm_trace_family_t families[MM_TRACE_MAX_FAMILIES];
+    mm_trace_record_t records[0];
+}mm_trace_header_t;
+
+/* slot of the live object map of a trace: object address -> object id */
+typedef struct _mm_trace_slot{
+
+    uintptr_t addr; // 0 for an empty slot
+    uint32_t object_id;
+    uint16_t family_id;
+}mm_trace_slot_t;
+
+/*
+ * live object map of a trace writer, open addressing with linear probing. It is mapped straight
+ * from the kernel so that a writer never allocates from the allocator it records
+ */
+typedef struct _mm_trace_map{
+
+    mm_trace_slot_t* slots;
+    uint32_t size; // number of slots, power of 2
+    uint32_t count;
+}mm_trace_map_t;
+
+
+static inline uint32_t mm_trace_map_slot(const mm_trace_map_t* map, uintptr_t addr){
+
+    return (uint32_t)(((addr >> 3) * 0x9e3779b97f4a7c15ull) >> 32) & (map->size - 1);
+}
+
+
+/**
+ * double the map, return 0 when the kernel has no memory for it
+ */ 
+static inline int mm_trace_map_grow(mm_trace_map_t* map){
+
+    uint32_t old_size = map->size;
+    uint32_t new_size = old_size ? old_size * 2 : 4096;
+    mm_trace_slot_t* old_slots = map->slots;
+    mm_trace_slot_t* new_slots = mmap(0, new_size * sizeof(mm_trace_slot_t), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    uint32_t i = 0, slot = 0;
+
+    if(new_slots == MAP_FAILED){
+
+        return 0;
+    }
+
+    map->slots = new_slots;
+    map->size = new_size;
+
+    for(i=0; i<old_size; i++){
+
+        if(old_slots[i].addr){
+
+            for(slot = mm_trace_map_slot(map, old_slots[i].addr); new_slots[slot].addr; slot = (slot + 1) & (new_size - 1));
+            new_slots[slot] = old_slots[i];
+        }
+    }
+
+    if(old_slots){
+
+        munmap(old_slots, old_size * sizeof(mm_trace_slot_t));
+    }
+
+    return 1;
+}
+
+
+/**
+ * put a live object into the map, the map doubles at half load
+ */ 
+static inline void mm_trace_map_put(mm_trace_map_t* map, uintptr_t addr, uint32_t object_id, uint16_t family_id){
+
+    uint32_t slot = 0;
+
+    /* an object the full map can't take is not traced */
+    if((map->count + 1) * 2 > map->size && mm_trace_map_grow(map) == 0){
+
+        return;
+    }
+
+    for(slot = mm_trace_map_slot(map, addr); map->slots[slot].addr && map->slots[slot].addr != addr;
+        slot = (slot + 1) & (map->size - 1));
+
+    if(map->slots[slot].addr == 0){
+
+        map->count++;
+    }
+
+    map->slots[slot].addr = addr;
+    map->slots[slot].object_id = object_id;
+    map->slots[slot].family_id = family_id;
+}
+
+
+/**
+ * remove addr from the map, the slots after it are shifted back so that no probe
+ * sequence is broken, return 0 for an object that is not traced
+ */ 
+static inline int mm_trace_map_take(mm_trace_map_t* map, uintptr_t addr, mm_trace_slot_t* entry){
+
+    uint32_t mask = map->size - 1;
+    uint32_t slot = 0, next = 0, home = 0;
+
+    if(map->slots == NULL){
+
+        return 0;
+    }
+
+    for(slot = mm_trace_map_slot(map, addr); map->slots[slot].addr != addr; slot = (slot + 1) & mask){
+
+        if(map->slots[slot].addr == 0){
+
+            return 0;
+        }
+    }
+
+    *entry = map->slots[slot];
+
+    for(next = (slot + 1) & mask; map->slots[next].addr; next = (next + 1) & mask){
+
+        home = mm_trace_map_slot(map, map->slots[next].addr);
+
+        /* an entry whose home is cyclically in (slot, next] stays where it is */
+        if(((next - home) & mask) < ((next - slot) & mask)){
+
+            continue;
+        }
+
+        map->slots[slot] = map->slots[next];
+        slot = next;
+    }
+
+    map->slots[slot].addr = 0;
+    map->count--;
+    return 1;
+}
+
+
+/**
+ * unmap the map, it can be filled again afterwards
+ */ 
+static inline void mm_trace_map_destroy(mm_trace_map_t* map){
+
+    if(map->slots){
+
+        munmap(map->slots, map->size * sizeof(mm_trace_slot_t));
+        map->slots = NULL;
+        map->size = 0;
+        map->count = 0;
+    }
+}
+
+#endif /* __MM_TRACE_H_ */
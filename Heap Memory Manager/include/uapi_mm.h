@@ -3,11 +3,40 @@
 
 #include "mm.h"
 
-#define MM_REG_STRUCT(struct_name) mm_instantiate_new_page_family(#struct_name, sizeof(struct_name))
+#define MM_REG_STRUCT(struct_name) mm_instantiate_new_page_family(#struct_name, sizeof(struct_name), 0)
+#define MM_REG_STRUCT_ATTR(struct_name, flags) mm_instantiate_new_page_family(#struct_name, sizeof(struct_name), flags)
 
 void testapp_demo(void);
+void testapp_realloc_nozero(void);
 void mm_print_memory_usage(void);
 void* zalloc(char* struct_name, int units);
+void* zalloc_family(vm_page_family_t* page_family, int units);
+void* zalloc_family_nozero(vm_page_family_t* page_family, int units);
+void* zalloc_nozero(char* struct_name, int units);
+void* zalloc_aligned(char* struct_name, int units, uint32_t alignment);
+void* zalloc_family_aligned(vm_page_family_t* page_family, int units, uint32_t alignment);
 void zfree(void* addr);
+/* only rejects addresses outside the pages of the memory manager, it does not validate object starts */
+vm_bool_t mm_owns(const void* addr);
+int zalloc_batch(vm_page_family_t* page_family, int units, int n, void** out_ptrs);
+void zfree_batch(void** ptrs, int n);
+void* zrealloc(void* addr, int new_units);
+void mm_arena_init(mm_arena_t* arena);
+void* zalloc_arena(mm_arena_t* arena, vm_page_family_t* page_family, int units);
+void mm_arena_reset(mm_arena_t* arena);
+void mm_arena_destroy(mm_arena_t* arena);
+uint32_t mm_trim(void);
+uint32_t mm_get_stats(mm_stats_t* stats, mm_family_stats_t* family_stats, uint32_t max_families);
+#if MM_QUOTAS
+vm_bool_t mm_set_family_quota(vm_page_family_t* page_family, uint64_t max_pages, uint64_t max_bytes);
+#endif
+#if MM_TRACE
+vm_bool_t mm_trace_start(const char* path, uint32_t capacity);
+void mm_trace_stop(void);
+#endif
+#if MM_LATENCY_HIST
+vm_bool_t mm_get_latency_stats(vm_page_family_t* page_family, mm_latency_stats_t* stats);
+void mm_print_latency_stats(void);
+#endif
 
 #endif /* __UAPI_MM_H_ */
\ No newline at end of file
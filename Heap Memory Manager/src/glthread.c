@@ -121,7 +121,8 @@ void glthread_priority_insert(glthread_node_t* base_glthread,
         if(comp_fn(GLTHREAD_GET_USER_DATA_FROM_OFFSET(new_glthread, offset), 
                 GLTHREAD_GET_USER_DATA_FROM_OFFSET(cur, offset)) == -1){
 
-            glthread_add(cur, new_glthread);
+            /* the head was checked above, so cur has a predecessor */
+            glthread_add(pre, new_glthread);
             return;
         }
 
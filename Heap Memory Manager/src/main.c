@@ -2,6 +2,7 @@
 
 int main(){
 
+	testapp_realloc_nozero();
 	testapp_demo();
 	return 0;
 }
\ No newline at end of file
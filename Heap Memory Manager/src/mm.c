@@ -1,7 +1,347 @@
+#define _GNU_SOURCE // mremap()
 #include "mm.h"
 
-static size_t SYSTEM_PAGE_SIZE = 0;
-static vm_page_family_list_t *first_vm_page_for_family = NULL;
+size_t mm_system_page_size = 0;
+
+/* registered page families by family_id, see MM_FAMILY_CHUNK_BASE, and their open addressing hash index by struct_name */
+static vm_page_family_t* family_chunks[MM_FAMILY_CHUNKS];
+static vm_page_family_t** family_name_index = NULL;
+static uint32_t family_name_index_size = 0; // number of slots, power of 2
+static uint32_t family_count = 0; // published once the family is set up, readers walk the registry without a lock
+
+#if MM_THREAD_SAFE
+/* the registry of page families is shared by all threads */
+static pthread_rwlock_t mm_registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* every heap ever created, the heap of an exited thread is adopted by the next new thread */
+static pthread_mutex_t mm_heap_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static mm_heap_t* first_heap = NULL;
+static pthread_key_t mm_heap_key;
+static pthread_once_t mm_heap_key_once = PTHREAD_ONCE_INIT;
+static __thread mm_heap_t* mm_thread_heap = NULL;
+
+/* an object on the remote free list of a heap holds the link in its first word and this mark in its second,
+ * so that it is not handed over or freed a second time before the owner drains the list */
+#define MM_REMOTE_FREE_MARK(heap_ptr)           ((uintptr_t)(heap_ptr) ^ 0x9e3779b97f4a7c15ull)
+#define MM_REMOTE_FREE_MARKED(heap_ptr, addr)   (((const uintptr_t*)(addr))[1] == MM_REMOTE_FREE_MARK(heap_ptr))
+
+#define MM_LOCK(lock)       pthread_mutex_lock(lock)
+#define MM_UNLOCK(lock)     pthread_mutex_unlock(lock)
+#else
+#define MM_LOCK(lock)
+#define MM_UNLOCK(lock)
+#endif
+
+#if MM_LATENCY_HIST
+/**
+ * current time in histogram ticks
+ */ 
+static inline uint64_t mm_hist_ticks(void){
+
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+
+/**
+ * count one sample of 'ticks' in the histogram of op, the owner of the family is the only writer
+ */ 
+static inline void mm_hist_record(vm_page_family_t* vm_page_family, mm_hist_op_t op, uint64_t ticks){
+
+    uint32_t bucket = ticks ? 63 - __builtin_clzll(ticks) : 0;
+    uint64_t* count = &vm_page_family->latency.hist[op][bucket < MM_HIST_BUCKETS ? bucket : MM_HIST_BUCKETS - 1];
+
+    __atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+}
+
+#define MM_HIST_START(start)                            uint64_t start = mm_hist_ticks()
+#define MM_HIST_RECORD(vm_page_family_ptr, op, start)   mm_hist_record(vm_page_family_ptr, op, mm_hist_ticks() - (start))
+#define MM_COUNT_SPLIT(vm_page_family_ptr, kind)                                            \
+    __atomic_store_n(&(vm_page_family_ptr)->latency.splits[kind],                           \
+            (vm_page_family_ptr)->latency.splits[kind] + 1, __ATOMIC_RELAXED)
+#else
+#define MM_HIST_START(start)
+#define MM_HIST_RECORD(vm_page_family_ptr, op, start)
+#define MM_COUNT_SPLIT(vm_page_family_ptr, kind)
+#endif
+
+/* family counters have one writer, the owner of the family, and are read by mm_get_stats() from any thread */
+#define MM_COUNTER_ADD(vm_page_family_ptr, counter, value)                              \
+    __atomic_store_n(&(vm_page_family_ptr)->counters.counter,                           \
+            (vm_page_family_ptr)->counters.counter + (value), __ATOMIC_RELAXED)
+#define MM_COUNTER_SUB(vm_page_family_ptr, counter, value)                              \
+    __atomic_store_n(&(vm_page_family_ptr)->counters.counter,                           \
+            (vm_page_family_ptr)->counters.counter - (value), __ATOMIC_RELAXED)
+
+/* empty VM pages retained by all page families, shared by all threads */
+static vm_page_t* global_page_cache = NULL;
+static uint32_t global_page_cache_count = 0;
+static uint32_t global_page_cache_high = MM_GLOBAL_PAGE_CACHE_HIGH;
+static uint32_t global_page_cache_low = MM_GLOBAL_PAGE_CACHE_LOW;
+#if MM_THREAD_SAFE
+static pthread_mutex_t mm_page_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* VM page -> page family map, the leaves are mapped on first use and never released */
+static vm_page_family_t** mm_page_map[1u << MM_PAGE_MAP_ROOT_BITS];
+#if MM_THREAD_SAFE
+static pthread_mutex_t mm_page_map_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* reserved regions that still have free pages, and the number of regions mapped */
+static mm_region_t* partial_regions = NULL;
+static mm_region_t* partial_huge_regions = NULL;
+static uint32_t region_count = 0;
+static uint32_t released_page_count = 0; // of all regions
+#if MM_THREAD_SAFE
+static pthread_mutex_t mm_region_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#if MM_TRACE
+/* allocation trace ring and the live object map, guarded by mm_trace_lock, see mm_trace_start() */
+static mm_trace_header_t* mm_trace = NULL;
+static size_t mm_trace_length = 0;
+static uint64_t mm_trace_last_ns = 0;
+static uint32_t mm_trace_next_id = 0;
+static mm_trace_map_t mm_trace_map = {NULL, 0, 0};
+#if MM_THREAD_SAFE
+static pthread_mutex_t mm_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t mm_trace_muted = 0; // the calls zrealloc() makes are recorded as one
+#else
+static uint32_t mm_trace_muted = 0;
+#endif
+#endif
+
+
+#if MM_TRACE
+static inline uint64_t mm_trace_now_ns(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * append a record to the ring, the first record of a family fills in its entry of the family table
+ */ 
+static void mm_trace_append(mm_trace_op_t op, vm_page_family_t* vm_page_family, uint16_t family_id, uint32_t units,
+                            uint32_t object_id, uint32_t alignment){
+
+    mm_trace_record_t* record = &mm_trace->records[mm_trace->head % mm_trace->capacity];
+    uint64_t now = mm_trace_now_ns();
+
+    if(vm_page_family && family_id < MM_TRACE_MAX_FAMILIES && mm_trace->families[family_id].struct_size == 0){
+
+        mm_trace_family_t* family = &mm_trace->families[family_id];
+
+        memcpy(family->struct_name, vm_page_family->struct_name, MM_TRACE_NAME_LEN - 1);
+        family->flags = vm_page_family->flags;
+        family->struct_size = vm_page_family->struct_size;
+    }
+
+    record->op = (uint8_t)op;
+    record->align_shift = (uint8_t)__builtin_ctz(alignment);
+    record->family_id = family_id;
+    record->units = units;
+    record->object_id = object_id;
+    record->delta_ns = now - mm_trace_last_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)(now - mm_trace_last_ns);
+    mm_trace_last_ns = now;
+
+    /* a reader of the live file sees the record before the head that covers it */
+    __atomic_store_n(&mm_trace->head, mm_trace->head + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * record the allocation of a new object of 'units' structures
+ */ 
+static void mm_trace_alloc(void* addr, vm_page_family_t* vm_page_family, uint32_t units, uint32_t alignment){
+
+    if(addr == NULL || mm_trace_muted || __atomic_load_n(&mm_trace, __ATOMIC_RELAXED) == NULL){
+
+        return;
+    }
+
+    MM_LOCK(&mm_trace_lock);
+
+    if(mm_trace){
+
+        uint32_t object_id = mm_trace_next_id++;
+        uint16_t family_id = (uint16_t)vm_page_family->family_id;
+
+        mm_trace_map_put(&mm_trace_map, (uintptr_t)addr, object_id, family_id);
+        mm_trace_append(MM_TRACE_ALLOC, vm_page_family, family_id, units, object_id, alignment);
+    }
+
+    MM_UNLOCK(&mm_trace_lock);
+}
+
+
+/**
+ * record the free of an object, before the memory can be handed out again. Objects allocated
+ * before the trace started, arena objects and foreign pointers are not in the map
+ */ 
+static void mm_trace_free(void* addr){
+
+    mm_trace_slot_t entry;
+
+    if(addr == NULL || mm_trace_muted || __atomic_load_n(&mm_trace, __ATOMIC_RELAXED) == NULL){
+
+        return;
+    }
+
+    MM_LOCK(&mm_trace_lock);
+
+    if(mm_trace && mm_trace_map_take(&mm_trace_map, (uintptr_t)addr, &entry)){
+
+        mm_trace_append(MM_TRACE_FREE, NULL, entry.family_id, 0, entry.object_id, 1);
+    }
+
+    MM_UNLOCK(&mm_trace_lock);
+}
+
+
+/**
+ * take an object that zrealloc() is about to resize out of the map, so that another thread reusing its
+ * address in the meantime is not mistaken for it
+ */ 
+static vm_bool_t mm_trace_realloc_begin(void* addr, mm_trace_slot_t* entry){
+
+    vm_bool_t traced = MM_FALSE;
+
+    if(addr == NULL || __atomic_load_n(&mm_trace, __ATOMIC_RELAXED) == NULL){
+
+        return MM_FALSE;
+    }
+
+    MM_LOCK(&mm_trace_lock);
+    traced = mm_trace && mm_trace_map_take(&mm_trace_map, (uintptr_t)addr, entry) ? MM_TRUE : MM_FALSE;
+    MM_UNLOCK(&mm_trace_lock);
+
+    return traced;
+}
+
+
+/**
+ * record the outcome of zrealloc() for an object taken out by mm_trace_realloc_begin()
+ */ 
+static void mm_trace_realloc_end(void* addr, void* new_addr, int new_units, mm_trace_slot_t* entry){
+
+    MM_LOCK(&mm_trace_lock);
+
+    if(mm_trace){
+
+        if(new_units <= 0){
+
+            mm_trace_append(MM_TRACE_FREE, NULL, entry->family_id, 0, entry->object_id, 1);
+        }else if(new_addr == NULL){
+
+            /* the object is unchanged */
+            mm_trace_map_put(&mm_trace_map, (uintptr_t)addr, entry->object_id, entry->family_id);
+        }else{
+
+            mm_trace_map_put(&mm_trace_map, (uintptr_t)new_addr, entry->object_id, entry->family_id);
+            mm_trace_append(MM_TRACE_REALLOC, NULL, entry->family_id, (uint32_t)new_units, entry->object_id, 1);
+        }
+    }
+
+    MM_UNLOCK(&mm_trace_lock);
+}
+
+
+/**
+ * stop the trace and unmap the ring and the live object map, the records stay in the file
+ */ 
+static void mm_trace_close(void){
+
+    if(mm_trace){
+
+        munmap(mm_trace, mm_trace_length);
+        __atomic_store_n(&mm_trace, NULL, __ATOMIC_RELAXED);
+    }
+
+    mm_trace_map_destroy(&mm_trace_map);
+}
+
+
+/**
+ * trace the allocations of all threads into a ring file of 'capacity' records at path, 0 for
+ * MM_TRACE_DEFAULT_RECORDS, a trace already running is stopped first. Objects live before the
+ * trace started are not traced
+ */ 
+vm_bool_t mm_trace_start(const char* path, uint32_t capacity){
+
+    capacity = capacity ? capacity : MM_TRACE_DEFAULT_RECORDS;
+
+    size_t length = sizeof(mm_trace_header_t) + (size_t)capacity * sizeof(mm_trace_record_t);
+    mm_trace_header_t* header = NULL;
+    int fd = -1;
+
+    if(path == NULL || (fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1){
+
+        return MM_FALSE;
+    }
+
+    if(ftruncate(fd, (off_t)length) == -1){
+
+        close(fd);
+        return MM_FALSE;
+    }
+
+    header = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(header == MAP_FAILED){
+
+        #if MM_DEBUG
+            printf("Fail to map trace file %s!\n", path);
+        #endif
+
+        return MM_FALSE;
+    }
+
+    /* the file was truncated, the family table and the records read as zero */
+    header->magic = MM_TRACE_MAGIC;
+    header->version = MM_TRACE_VERSION;
+    header->record_size = sizeof(mm_trace_record_t);
+    header->capacity = capacity;
+
+    MM_LOCK(&mm_trace_lock);
+    mm_trace_close();
+    mm_trace_length = length;
+    mm_trace_last_ns = mm_trace_now_ns();
+    mm_trace_next_id = 0;
+    __atomic_store_n(&mm_trace, header, __ATOMIC_RELAXED);
+    MM_UNLOCK(&mm_trace_lock);
+
+    return MM_TRUE;
+}
+
+
+/**
+ * stop tracing, the ring file keeps the records written so far
+ */ 
+void mm_trace_stop(void){
+
+    MM_LOCK(&mm_trace_lock);
+    mm_trace_close();
+    MM_UNLOCK(&mm_trace_lock);
+}
+
+#define MM_TRACE_RECORD_ALLOC(addr, vm_page_family_ptr, units, alignment)  mm_trace_alloc(addr, vm_page_family_ptr, units, alignment)
+#define MM_TRACE_RECORD_FREE(addr)                                         mm_trace_free(addr)
+#else
+#define MM_TRACE_RECORD_ALLOC(addr, vm_page_family_ptr, units, alignment)
+#define MM_TRACE_RECORD_FREE(addr)
+#endif
 
 
 /**
@@ -10,6 +350,15 @@ static vm_page_family_list_t *first_vm_page_for_family = NULL;
 void mm_init(){
 
     SYSTEM_PAGE_SIZE = getpagesize();
+    /* meta block links are 16 bit page offsets */
+    assert(SYSTEM_PAGE_SIZE <= 65536);
+
+#if MM_TRACE
+    if(getenv("MM_TRACE_FILE")){
+
+        mm_trace_start(getenv("MM_TRACE_FILE"), 0);
+    }
+#endif
 }
 
 
@@ -27,8 +376,8 @@ static void* mm_get_vm_page(uint32_t units){
         return NULL;
     }
 
-    size_t length = units * SYSTEM_PAGE_SIZE;
-    int prot = PROT_READ | PROT_WRITE | PROT_EXEC;
+    size_t length = (size_t)units * SYSTEM_PAGE_SIZE;
+    int prot = PROT_READ | PROT_WRITE;
     int flag = MAP_ANON | MAP_PRIVATE;
 
     uint8_t* vm_page = mmap(0, length, prot, flag, 0, 0);
@@ -42,7 +391,7 @@ static void* mm_get_vm_page(uint32_t units){
         return NULL;
     }
 
-    memset(vm_page, 0x0, length);
+    /* anonymous mappings are zero filled by the kernel */
 
     #if MM_DEBUG
         printf("Successfully mmap VM page from kernel!\n\n");
@@ -66,7 +415,7 @@ static void mm_release_vm_page(void* vm_page, uint32_t units){
         return;
     }
 
-    size_t length = units * SYSTEM_PAGE_SIZE;
+    size_t length = (size_t)units * SYSTEM_PAGE_SIZE;
 
     if(munmap(vm_page, length) == -1){
 
@@ -82,661 +431,3733 @@ static void mm_release_vm_page(void* vm_page, uint32_t units){
 
 
 /**
- * union two free blocks
+ * reserve a new MM_REGION_SIZE aligned region, its pages are not touched until they are carved,
+ * a huge region asks the kernel for transparent huge pages and silently falls back to normal pages
  */ 
-static void mm_union_free_blocks(meta_blk_t* first, meta_blk_t* second){
+static mm_region_t* mm_region_reserve(vm_bool_t huge){
 
-    assert(first->is_free == MM_TRUE && second->is_free == MM_TRUE);
+    if(SYSTEM_PAGE_SIZE == 0 || SYSTEM_PAGE_SIZE > MM_REGION_SIZE / 2){
 
-    glthread_remove(&first->priority_thread_glue);
-    glthread_remove(&second->priority_thread_glue);
+        return NULL;
+    }
 
-    first->data_blk_size += META_SIZE + second->data_blk_size;
-    MM_BIND_BLKS_FOR_DEALLOCATION(first, second);
-}
+    size_t length = 2 * (size_t)MM_REGION_SIZE;
+    int prot = PROT_READ | PROT_WRITE;
+    int flag = MAP_ANON | MAP_PRIVATE;
 
+    /* over-map by one region and trim both ends to get the alignment */
+    uint8_t* addr = mmap(0, length, prot, flag, 0, 0);
 
-/**
- * return the max size of VM Page
- */ 
-static inline uint32_t mm_max_page_allocatable_memory(int units){
+    if(addr == MAP_FAILED){
 
-    if(units == 0 || SYSTEM_PAGE_SIZE == 0){
+        #if MM_DEBUG
+            printf("Fail to reserve VM region from kernel!\n");
+        #endif
+
+        return NULL;
+    }
+
+    uint8_t* base = (uint8_t*)(((uintptr_t)addr + MM_REGION_SIZE - 1) & ~((uintptr_t)MM_REGION_SIZE - 1));
+
+    if(base > addr){
+
+        munmap(addr, base - addr);
+    }
+
+    if(addr + length > base + MM_REGION_SIZE){
+
+        munmap(base + MM_REGION_SIZE, (addr + length) - (base + MM_REGION_SIZE));
+    }
+
+    if(huge && madvise(base, MM_REGION_SIZE, MADV_HUGEPAGE) == -1){
 
         #if MM_DEBUG
-            printf("System Page is 0!\n");
+            printf("Transparent huge pages are not available!\n");
         #endif
+    }
 
-        return 0;
+    mm_region_t* region = (mm_region_t*)base;
+    region->huge = huge;
+    region->next = NULL;
+    region->pre = NULL;
+    region->page_count = MM_REGION_SIZE / SYSTEM_PAGE_SIZE - 1;
+    region->free_page_count = region->page_count;
+    region->clean_page_index = 1;
+    region->released_page_count = 0;
+
+    for(uint32_t i=1; i<=region->page_count; i++){
+
+        region->free_map[i / 64] |= 1ull << (i % 64);
     }
 
-    return (uint32_t)((SYSTEM_PAGE_SIZE * units) - offset_of(vm_page_t, page_data_blk));
+    #if MM_DEBUG
+        printf("Successfully reserve VM region %p from kernel!\n", region);
+    #endif
+
+    return region;
 }
 
 
 /**
- * 
- * Return -1: meta_blk_data1 size is greater than meta_blk_data2
- * Return 1: meta_blk_data2 size is greater than meta_blk_data1
- * Return 0: meta_blk_data1 size is equal to meta_blk_data2
- * 
+ * carve a free system page out of the reserved (huge) regions, reserve a new region if all are full,
+ * 'clean' tells whether the page was never handed out since the region was mapped
  */ 
-static int free_blocks_comparison_function(void* meta_blk_data1, void* meta_blk_data2){
+static void* mm_region_get_page(vm_bool_t huge, vm_bool_t* clean){
 
-    assert(meta_blk_data1 && meta_blk_data2);
+    void* vm_page = NULL;
+    mm_region_t** partial_list = huge ? &partial_huge_regions : &partial_regions;
 
-    if(((meta_blk_t*)meta_blk_data1)->data_blk_size > ((meta_blk_t*)meta_blk_data2)->data_blk_size){
+    MM_LOCK(&mm_region_lock);
 
-        return -1;
-    }else if(((meta_blk_t*)meta_blk_data1)->data_blk_size < ((meta_blk_t*)meta_blk_data2)->data_blk_size){
+    mm_region_t* region = *partial_list;
 
-        return 1;
+    if(region == NULL){
+
+        if((region = mm_region_reserve(huge)) == NULL){
+
+            MM_UNLOCK(&mm_region_lock);
+            return NULL;
+        }
+
+        *partial_list = region;
+        ++region_count;
     }
 
-    return 0;
-}
+    for(uint32_t i=0; i<MM_REGION_MAP_WORDS; i++){
 
+        if(region->free_map[i]){
 
-/**
- * Add a given free meta block to a Priority Queue of a given Page family 
- */ 
-static void mm_add_free_meta_block_to_free_block_list(vm_page_family_t* vm_page_family, meta_blk_t* free_blk){
+            uint32_t page = i * 64 + __builtin_ctzll(region->free_map[i]);
 
-    if(free_blk == NULL){
+            region->free_map[i] &= ~(1ull << (page % 64));
+            vm_page = (uint8_t*)region + (size_t)page * SYSTEM_PAGE_SIZE;
 
-        return;
+            /* pages are carved lowest first, so every page below clean_page_index has been used */
+            *clean = page >= region->clean_page_index ? MM_TRUE : MM_FALSE;
+            if(*clean){
+
+                region->clean_page_index = page + 1;
+            }else if(region->released_map[i] & (1ull << (page % 64))){
+
+                region->released_map[i] &= ~(1ull << (page % 64));
+                --region->released_page_count;
+                --released_page_count;
+                *clean = MM_TRIM_ADVICE == MADV_DONTNEED ? MM_TRUE : MM_FALSE;
+            }
+            break;
+        }
     }
 
-    assert(free_blk->is_free == MM_TRUE);
+    assert(vm_page);
 
-    glthread_priority_insert(&vm_page_family->free_blks_pq,
-            &free_blk->priority_thread_glue,
-            free_blocks_comparison_function,
-            offset_of(meta_blk_t, priority_thread_glue));
+    /* a full region leaves the partial list */
+    if(--region->free_page_count == 0){
+
+        *partial_list = region->next;
+        if(region->next){
+
+            region->next->pre = NULL;
+        }
+        region->next = NULL;
+    }
+
+    MM_UNLOCK(&mm_region_lock);
+
+    return vm_page;
 }
 
 
 /**
- * 
+ * give the memory of the free pages of a region that were used back to the kernel, every run of
+ * such pages takes one madvise(), return the number of pages released. Called with the region lock held
+ * so that no page is handed out while it is released
  */ 
-static vm_page_t* mm_family_add_new_page(vm_page_family_t *vm_page_family){
+static uint32_t mm_region_trim(mm_region_t* region){
 
-    vm_page_t* new_vm_page = allocate_vm_page(vm_page_family);
+    uint32_t page = 0, first = 0, released = 0;
+    vm_bool_t trim = MM_FALSE;
 
-    if(new_vm_page == NULL){
+    /* clean_page_index ends the last run, no page from there on was used */
+    for(page = 1; page <= region->clean_page_index; page++){
 
-        return NULL;
-    }   
+        trim = page < region->clean_page_index &&
+               (region->free_map[page / 64] & ~region->released_map[page / 64] & (1ull << (page % 64))) ? MM_TRUE : MM_FALSE;
 
-    /* add new meta block to the pq */
-    mm_add_free_meta_block_to_free_block_list(vm_page_family, &new_vm_page->meta_blk);
+        if(trim){
 
-    return new_vm_page;
+            first = first ? first : page;
+            continue;
+        }
+
+        if(first == 0){
+
+            continue;
+        }
+
+        if(madvise((uint8_t*)region + (size_t)first * SYSTEM_PAGE_SIZE, (size_t)(page - first) * SYSTEM_PAGE_SIZE, MM_TRIM_ADVICE) == 0){
+
+            for(; first < page; first++){
+
+                region->released_map[first / 64] |= 1ull << (first % 64);
+                ++released;
+            }
+        }
+
+        first = 0;
+    }
+
+    region->released_page_count += released;
+    released_page_count += released;
+
+    return released;
 }
 
 
 /**
- * return the best fit node of the Priority Queue
+ * give a system page back to the free map of its region, the region is unmapped once it is empty
  */ 
-static inline meta_blk_t* mm_get_biggest_free_block_page_family(vm_page_family_t* vm_page_family){
+static void mm_region_put_page(void* vm_page){
 
-    if(vm_page_family == NULL){
+    mm_region_t* region = MM_GET_REGION_FROM_PAGE(vm_page);
+    mm_region_t** partial_list = region->huge ? &partial_huge_regions : &partial_regions;
+    uint32_t page = (uint32_t)(((uint8_t*)vm_page - (uint8_t*)region) / SYSTEM_PAGE_SIZE);
 
-        #if MM_DEBUG
-            printf("vm_page_family is NULL!\n");
-        #endif
+    MM_LOCK(&mm_region_lock);
 
-        return NULL;
+    assert(!(region->free_map[page / 64] & (1ull << (page % 64))));
+    region->free_map[page / 64] |= 1ull << (page % 64);
+
+    /* a full region that gets a free page joins the partial list again */
+    if(region->free_page_count++ == 0){
+
+        region->pre = NULL;
+        region->next = *partial_list;
+        if(*partial_list){
+
+            (*partial_list)->pre = region;
+        }
+        *partial_list = region;
     }
 
-    glthread_node_t* biggest_free_blk = vm_page_family->free_blks_pq.right;
+    if(region->free_page_count < region->page_count){
 
-    if(biggest_free_blk){
+#if MM_AUTO_TRIM_PAGES
+        /* free pages at and above clean_page_index were never used */
+        if(region->free_page_count - (region->page_count + 1 - region->clean_page_index) -
+           region->released_page_count >= MM_AUTO_TRIM_PAGES){
 
-        return glthread_to_meta_block(biggest_free_blk);
+            mm_region_trim(region);
+        }
+#endif
+        MM_UNLOCK(&mm_region_lock);
+        return;
     }
 
-    return NULL;
-}
+    released_page_count -= region->released_page_count;
 
+    if(region->pre){
 
-/* 
- * mark meta block as being Allocated for 'size' bytes of application data
- * return MM_TRUE if allocation successed
- * return MM_FALSE if the allocation failed 
- */ 
-static vm_bool_t mm_split_free_data_block_for_allocation(vm_page_family_t* page_family, meta_blk_t* meta_blk, uint32_t size){
+        region->pre->next = region->next;
+    }else{
 
-    assert(page_family);
-    assert(meta_blk->is_free == MM_TRUE);
+        *partial_list = region->next;
+    }
 
-    if(meta_blk->data_blk_size < size){
+    if(region->next){
 
-        return MM_FALSE;
+        region->next->pre = region->pre;
     }
 
-    uint32_t remaining_size = meta_blk->data_blk_size - size;
-    meta_blk_t* remaining_blk = NULL;
-    meta_blk->is_free = MM_FALSE;
-    meta_blk->data_blk_size = size;
-    glthread_remove(&meta_blk->priority_thread_glue);
+    --region_count;
 
-    if(remaining_size == 0){ // no split
+    MM_UNLOCK(&mm_region_lock);
+
+    if(munmap(region, MM_REGION_SIZE) == -1){
 
         #if MM_DEBUG
-            printf("Split: no split\n");
+            printf("Fail to munmap VM region to kernel!\n");
         #endif
+    }
+}
 
-        return MM_TRUE;
-    }else if(remaining_size > META_SIZE &&
-             remaining_size < META_SIZE + page_family->struct_size){ // partial split: Soft Internal Fragmentation
 
-        #if MM_DEBUG
-            printf("Split: partial split(Soft IF)\n");
-        #endif
+/**
+ * return the page map slot of the VM page at vm_page, the leaf is mapped if 'create' is set,
+ * NULL if there is no leaf or the address is out of the range of the map
+ */ 
+static vm_page_family_t** mm_page_map_slot(const void* vm_page, vm_bool_t create){
 
-        remaining_blk = NEXT_META_BLOCK_BY_SIZE(meta_blk);
-        remaining_blk->is_free = MM_TRUE;
-        remaining_blk->data_blk_size = remaining_size - META_SIZE;
-        remaining_blk->offset = meta_blk->offset + META_SIZE + meta_blk->data_blk_size;
-        glthread_init(&remaining_blk->priority_thread_glue);
-        mm_add_free_meta_block_to_free_block_list(page_family, remaining_blk);
-        MM_BIND_BLKS_FOR_ALLOCATION(meta_blk, remaining_blk);
-    }else if(remaining_size < META_SIZE){ // partial split: Hard Internal Fragmentation
+    uintptr_t key = (uintptr_t)vm_page >> MM_PAGE_MAP_SHIFT;
+    vm_page_family_t** leaf = NULL;
 
-        #if MM_DEBUG
+    if(key >> (MM_PAGE_MAP_ROOT_BITS + MM_PAGE_MAP_LEAF_BITS)){
+
+        return NULL;
+    }
+
+    leaf = __atomic_load_n(&mm_page_map[key >> MM_PAGE_MAP_LEAF_BITS], __ATOMIC_ACQUIRE);
+
+    if(leaf == NULL && create){
+
+        MM_LOCK(&mm_page_map_lock);
+
+        if((leaf = mm_page_map[key >> MM_PAGE_MAP_LEAF_BITS]) == NULL){
+
+            /* untouched parts of a leaf cost no memory */
+            leaf = mm_get_vm_page((uint32_t)(((sizeof(vm_page_family_t*) << MM_PAGE_MAP_LEAF_BITS) + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE));
+            __atomic_store_n(&mm_page_map[key >> MM_PAGE_MAP_LEAF_BITS], leaf, __ATOMIC_RELEASE);
+        }
+
+        MM_UNLOCK(&mm_page_map_lock);
+    }
+
+    return leaf ? &leaf[key & ((1u << MM_PAGE_MAP_LEAF_BITS) - 1)] : NULL;
+}
+
+
+/**
+ * record that the VM page at vm_page belongs to the page family
+ */ 
+static void mm_page_map_set(vm_page_t* vm_page, vm_page_family_t* vm_page_family){
+
+    vm_page_family_t** slot = mm_page_map_slot(vm_page, MM_TRUE);
+
+    assert(slot);
+    __atomic_store_n(slot, vm_page_family, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * forget the VM page at vm_page unless the address has been handed to another page family since
+ */ 
+static void mm_page_map_clear(vm_page_t* vm_page, vm_page_family_t* vm_page_family){
+
+    vm_page_family_t** slot = mm_page_map_slot(vm_page, MM_FALSE);
+
+    if(slot){
+
+        __atomic_compare_exchange_n(slot, &vm_page_family, NULL, MM_FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ * O(1) check that addr lies in a VM page of the memory manager: the page map must know the VM page
+ * addr starts in and addr must be past the page header. The memory at addr is not read, so an interior
+ * or stale pointer into a live page passes, zfree() and zrealloc() check the block itself
+ */ 
+vm_bool_t mm_owns(const void* addr){
+
+    vm_page_family_t** slot = mm_page_map_slot(MM_GET_PAGE_FROM_ADDR(addr), MM_FALSE);
+
+    if(slot == NULL || __atomic_load_n(slot, __ATOMIC_ACQUIRE) == NULL){
+
+        return MM_FALSE;
+    }
+
+    return ((uintptr_t)addr & (SYSTEM_PAGE_SIZE - 1)) >= offset_of(vm_page_t, page_data_blk) ? MM_TRUE : MM_FALSE;
+}
+
+
+/**
+ * return the max size of VM Page
+ */ 
+static inline uint32_t mm_max_page_allocatable_memory(int units){
+
+    if(units == 0 || SYSTEM_PAGE_SIZE == 0){
+
+        #if MM_DEBUG
+            printf("System Page is 0!\n");
+        #endif
+
+        return 0;
+    }
+
+    return (uint32_t)((SYSTEM_PAGE_SIZE * units) - offset_of(vm_page_t, page_data_blk));
+}
+
+
+/**
+ * return the data block size of an object of 'total_struct_size' bytes, big enough for the free block
+ * list glue and rounded up to MM_DATA_BLK_ALIGN so that the block carved behind it stays aligned
+ */ 
+static inline uint32_t mm_data_blk_size(uint64_t total_struct_size){
+
+    if(total_struct_size < MM_MIN_DATA_BLK_SIZE){
+
+        return (uint32_t)MM_MIN_DATA_BLK_SIZE;
+    }
+
+    return (uint32_t)MM_ALIGN_UP(total_struct_size, MM_DATA_BLK_ALIGN);
+}
+
+
+/**
+ * return the number of system pages a single large object of 'size' bytes needs
+ */ 
+static inline uint32_t mm_large_object_page_units(uint32_t size){
+
+    size_t total = (size_t)size + offset_of(vm_page_t, page_data_blk);
+
+    return (uint32_t)((total + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+}
+
+
+#if MM_FREE_BLK_POLICY == MM_BEST_FIT_PQ
+/**
+ * 
+ * Return -1: meta_blk_data1 size is greater than meta_blk_data2
+ * Return 1: meta_blk_data2 size is greater than meta_blk_data1
+ * Return 0: meta_blk_data1 size is equal to meta_blk_data2
+ * 
+ */ 
+static int free_blocks_comparison_function(void* meta_blk_data1, void* meta_blk_data2){
+
+    assert(meta_blk_data1 && meta_blk_data2);
+
+    if(MM_META_BLK_SIZE((meta_blk_t*)meta_blk_data1) > MM_META_BLK_SIZE((meta_blk_t*)meta_blk_data2)){
+
+        return -1;
+    }else if(MM_META_BLK_SIZE((meta_blk_t*)meta_blk_data1) < MM_META_BLK_SIZE((meta_blk_t*)meta_blk_data2)){
+
+        return 1;
+    }
+
+    return 0;
+}
+#endif
+
+
+/**
+ * init the free block list of a given Page family
+ */ 
+static void mm_init_free_block_list(vm_page_family_t* vm_page_family){
+
+#if MM_FREE_BLK_POLICY == MM_SIZE_CLASS_BINS
+    vm_page_family->free_bins_bitmap = 0;
+    vm_page_family->free_bins_stale = 0;
+    for(uint32_t i=0; i<MM_MAX_FREE_BINS; i++){
+
+        vm_page_family->free_bins_largest[i] = 0;
+        glthread_init(&vm_page_family->free_bins[i]);
+    }
+#else
+    glthread_init(&vm_page_family->free_blks_pq);
+#endif
+#if MM_QUICK_LIST_MAX_SIZE
+    memset(vm_page_family->quick_lists, 0x0, sizeof(vm_page_family->quick_lists));
+    memset(vm_page_family->quick_counts, 0x0, sizeof(vm_page_family->quick_counts));
+    vm_page_family->quick_block_count = 0;
+#endif
+}
+
+
+/**
+ * Add a given free meta block to the free block list of a given Page family 
+ * size class bins: O(1) push to the head of the bin of its size
+ * best fit pq: sorted insertion
+ */ 
+static void mm_add_free_meta_block_to_free_block_list(vm_page_family_t* vm_page_family, meta_blk_t* free_blk){
+
+    if(free_blk == NULL){
+
+        return;
+    }
+
+    assert(MM_META_BLK_IS_FREE(free_blk) == MM_TRUE);
+    assert(MM_META_BLK_SIZE(free_blk) >= MM_MIN_DATA_BLK_SIZE);
+
+    /* the glue goes into the data area */
+    MM_MARK_VM_PAGE_DIRTY(((vm_page_t*)MM_GET_PAGE_FROM_META_BLOCK(free_blk)), MM_META_BLK_GLUE(free_blk) + 1);
+
+    MM_COUNTER_ADD(vm_page_family, free_blocks, 1);
+    if(MM_META_BLK_SIZE(free_blk) < vm_page_family->struct_size){
+
+        MM_COUNTER_ADD(vm_page_family, soft_if_bytes, META_SIZE + MM_META_BLK_SIZE(free_blk));
+    }
+
+#if MM_FREE_BLK_POLICY == MM_SIZE_CLASS_BINS
+    uint32_t bin = MM_SIZE_TO_BIN(MM_META_BLK_SIZE(free_blk));
+
+    glthread_init(MM_META_BLK_GLUE(free_blk));
+    glthread_add(&vm_page_family->free_bins[bin], MM_META_BLK_GLUE(free_blk));
+    vm_page_family->free_bins_bitmap |= (1u << bin);
+
+    /* a block at least as large as the bound is the largest of the bin */
+    if(MM_META_BLK_SIZE(free_blk) >= vm_page_family->free_bins_largest[bin]){
+
+        vm_page_family->free_bins_largest[bin] = MM_META_BLK_SIZE(free_blk);
+        vm_page_family->free_bins_stale &= ~(1u << bin);
+    }
+#else
+    glthread_priority_insert(&vm_page_family->free_blks_pq,
+            MM_META_BLK_GLUE(free_blk),
+            free_blocks_comparison_function,
+            META_SIZE);
+#endif
+}
+
+
+/**
+ * Remove a given free meta block from the free block list of a given Page family,
+ * must be called before the size of the block is changed
+ */ 
+static void mm_remove_free_meta_block_from_free_block_list(vm_page_family_t* vm_page_family, meta_blk_t* free_blk){
+
+    /* a block that was just freed is not on the list yet */
+    if(MM_META_BLK_GLUE(free_blk)->left == NULL){
+
+        return;
+    }
+
+    glthread_remove(MM_META_BLK_GLUE(free_blk));
+
+    MM_COUNTER_SUB(vm_page_family, free_blocks, 1);
+    if(MM_META_BLK_SIZE(free_blk) < vm_page_family->struct_size){
+
+        MM_COUNTER_SUB(vm_page_family, soft_if_bytes, META_SIZE + MM_META_BLK_SIZE(free_blk));
+    }
+
+#if MM_FREE_BLK_POLICY == MM_SIZE_CLASS_BINS
+    uint32_t bin = MM_SIZE_TO_BIN(MM_META_BLK_SIZE(free_blk));
+
+    if(vm_page_family->free_bins[bin].right == NULL){
+
+        vm_page_family->free_bins_bitmap &= ~(1u << bin);
+        vm_page_family->free_bins_stale &= ~(1u << bin);
+        vm_page_family->free_bins_largest[bin] = 0;
+    }else if(MM_META_BLK_SIZE(free_blk) == vm_page_family->free_bins_largest[bin]){
+
+        vm_page_family->free_bins_stale |= (1u << bin);
+    }
+#else
+    (void)vm_page_family;
+#endif
+}
+
+
+#if MM_QUOTAS
+/**
+ * raise a high water mark shared by all threads to value
+ */ 
+static inline void mm_quota_peak(uint64_t* peak, uint64_t value){
+
+    uint64_t current = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while(value > current && !__atomic_compare_exchange_n(peak, &current, value, MM_TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+/**
+ * charge 'units' system pages to the registered family, refused when that would take it above max_pages
+ */ 
+static inline vm_bool_t mm_quota_charge_pages(vm_page_family_t* vm_page_family, uint64_t units){
+
+    mm_family_quota_t* quota = &vm_page_family->reg_family->quota;
+    uint64_t pages = __atomic_add_fetch(&quota->pages, units, __ATOMIC_RELAXED);
+    uint64_t max_pages = __atomic_load_n(&quota->max_pages, __ATOMIC_RELAXED);
+
+    if(max_pages && pages > max_pages){
+
+        __atomic_sub_fetch(&quota->pages, units, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&quota->failures, 1, __ATOMIC_RELAXED);
+        return MM_FALSE;
+    }
+
+    mm_quota_peak(&quota->peak_pages, pages);
+    return MM_TRUE;
+}
+
+
+/**
+ * fail fast: reserve 'size' data bytes of a family owned by the calling thread before they are allocated,
+ * refused when that would take the registered family above max_bytes. Like the page quota the bytes are
+ * added first and taken back on failure, so concurrent allocations cannot pass the limit together.
+ * The block accounting of the allocation consumes the reservation, mm_quota_release_bytes() drops the rest
+ */ 
+static inline vm_bool_t mm_quota_reserve_bytes(vm_page_family_t* vm_page_family, uint64_t size){
+
+    mm_family_quota_t* quota = &vm_page_family->reg_family->quota;
+    uint64_t max_bytes = __atomic_load_n(&quota->max_bytes, __ATOMIC_RELAXED);
+    uint64_t bytes = 0;
+
+    if(max_bytes == 0){
+
+        return MM_TRUE;
+    }
+
+    if((bytes = __atomic_add_fetch(&quota->bytes, size, __ATOMIC_RELAXED)) > max_bytes){
+
+        __atomic_sub_fetch(&quota->bytes, size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&quota->failures, 1, __ATOMIC_RELAXED);
+        return MM_FALSE;
+    }
+
+    mm_quota_peak(&quota->peak_bytes, bytes);
+    vm_page_family->quota_reserved += size;
+
+    return MM_TRUE;
+}
+
+
+/**
+ * charge an allocated block, out of the reservation of the allocation in flight first
+ */ 
+static inline void mm_quota_charge_bytes(vm_page_family_t* vm_page_family, uint64_t size){
+
+    mm_family_quota_t* quota = &vm_page_family->reg_family->quota;
+    uint64_t reserved = vm_page_family->quota_reserved < size ? vm_page_family->quota_reserved : size;
+
+    vm_page_family->quota_reserved -= reserved;
+    if(size > reserved){
+
+        mm_quota_peak(&quota->peak_bytes, __atomic_add_fetch(&quota->bytes, size - reserved, __ATOMIC_RELAXED));
+    }
+}
+
+
+/**
+ * the allocation is over: give back what it reserved and did not charge
+ */ 
+static inline void mm_quota_release_bytes(vm_page_family_t* vm_page_family){
+
+    if(vm_page_family->quota_reserved){
+
+        __atomic_sub_fetch(&vm_page_family->reg_family->quota.bytes, vm_page_family->quota_reserved, __ATOMIC_RELAXED);
+        vm_page_family->quota_reserved = 0;
+    }
+}
+
+#define MM_QUOTA_CHARGE_PAGES(vm_page_family_ptr, units)    mm_quota_charge_pages(vm_page_family_ptr, units)
+#define MM_QUOTA_UNCHARGE_PAGES(vm_page_family_ptr, units)  \
+        __atomic_sub_fetch(&(vm_page_family_ptr)->reg_family->quota.pages, (units), __ATOMIC_RELAXED)
+#define MM_QUOTA_RESERVE_BYTES(vm_page_family_ptr, size)    mm_quota_reserve_bytes(vm_page_family_ptr, size)
+#define MM_QUOTA_RELEASE_BYTES(vm_page_family_ptr)          mm_quota_release_bytes(vm_page_family_ptr)
+#define MM_QUOTA_CHARGE_BYTES(vm_page_family_ptr, size)     mm_quota_charge_bytes(vm_page_family_ptr, size)
+#define MM_QUOTA_UNCHARGE_BYTES(vm_page_family_ptr, size)   \
+        __atomic_sub_fetch(&(vm_page_family_ptr)->reg_family->quota.bytes, (size), __ATOMIC_RELAXED)
+#else
+#define MM_QUOTA_CHARGE_PAGES(vm_page_family_ptr, units)    MM_TRUE
+#define MM_QUOTA_UNCHARGE_PAGES(vm_page_family_ptr, units)
+#define MM_QUOTA_RESERVE_BYTES(vm_page_family_ptr, size)    MM_TRUE
+#define MM_QUOTA_RELEASE_BYTES(vm_page_family_ptr)
+#define MM_QUOTA_CHARGE_BYTES(vm_page_family_ptr, size)
+#define MM_QUOTA_UNCHARGE_BYTES(vm_page_family_ptr, size)
+#endif
+
+
+/**
+ * account an allocated block of 'size' data bytes followed by 'hard_IF' bytes nobody can use
+ */ 
+static inline void mm_count_allocated_block(vm_page_family_t* vm_page_family, uint32_t size, uint64_t hard_IF){
+
+    MM_COUNTER_ADD(vm_page_family, allocated_blocks, 1);
+    MM_COUNTER_ADD(vm_page_family, bytes_in_use, size);
+    MM_COUNTER_ADD(vm_page_family, hard_if_bytes, hard_IF);
+    MM_QUOTA_CHARGE_BYTES(vm_page_family, size);
+}
+
+
+/**
+ * undo mm_count_allocated_block() when the block is freed
+ */ 
+static inline void mm_count_freed_block(vm_page_family_t* vm_page_family, uint32_t size, uint64_t hard_IF){
+
+    MM_COUNTER_SUB(vm_page_family, allocated_blocks, 1);
+    MM_COUNTER_SUB(vm_page_family, bytes_in_use, size);
+    MM_COUNTER_SUB(vm_page_family, hard_if_bytes, hard_IF);
+    MM_QUOTA_UNCHARGE_BYTES(vm_page_family, size);
+}
+
+
+/**
+ * return the bytes between the end of the data of a block and the next meta block, or the end of its VM page
+ */ 
+static uint64_t mm_block_hard_IF(meta_blk_t* meta_blk){
+
+    meta_blk_t* next_meta_blk = NEXT_META_BLOCK(meta_blk);
+    vm_page_t* vm_page = MM_GET_PAGE_FROM_META_BLOCK(meta_blk);
+    uint8_t* tail_of_data_blk = (uint8_t*)NEXT_META_BLOCK_BY_SIZE(meta_blk);
+
+    if(next_meta_blk){
+
+        return (uint64_t)((uint8_t*)next_meta_blk - tail_of_data_blk);
+    }
+
+    return (uint64_t)((uint8_t*)vm_page + vm_page->page_units * SYSTEM_PAGE_SIZE - tail_of_data_blk);
+}
+
+
+/**
+ * union two free blocks
+ */ 
+static void mm_union_free_blocks(vm_page_family_t* vm_page_family, meta_blk_t* first, meta_blk_t* second){
+
+    assert(MM_META_BLK_IS_FREE(first) == MM_TRUE && MM_META_BLK_IS_FREE(second) == MM_TRUE);
+
+    mm_remove_free_meta_block_from_free_block_list(vm_page_family, first);
+    mm_remove_free_meta_block_from_free_block_list(vm_page_family, second);
+
+    MM_META_BLK_SET_SIZE(first, MM_META_BLK_SIZE(first) + META_SIZE + MM_META_BLK_SIZE(second));
+    MM_BIND_BLKS_FOR_DEALLOCATION(first, second);
+}
+
+
+/**
+ * 
+ */ 
+static vm_page_t* mm_family_add_new_page(vm_page_family_t *vm_page_family){
+
+    vm_page_t* new_vm_page = allocate_vm_page(vm_page_family, 1);
+
+    if(new_vm_page == NULL){
+
+        return NULL;
+    }   
+
+    /* add new meta block to the free block list */
+    mm_add_free_meta_block_to_free_block_list(vm_page_family, &new_vm_page->meta_blk);
+
+    return new_vm_page;
+}
+
+
+/**
+ * return a free block of the Page family that can hold 'size' bytes
+ * size class bins: take the first non-empty bin whose blocks all fit (bit scan),
+ *                  otherwise look at a few blocks of the request's own bin
+ * best fit pq: the node of the Priority Queue
+ */ 
+static inline meta_blk_t* mm_get_free_block_page_family(vm_page_family_t* vm_page_family, uint32_t size){
+
+    if(vm_page_family == NULL){
+
+        #if MM_DEBUG
+            printf("vm_page_family is NULL!\n");
+        #endif
+
+        return NULL;
+    }
+
+#if MM_FREE_BLK_POLICY == MM_SIZE_CLASS_BINS
+    uint32_t bin = MM_SIZE_TO_BIN(size);
+    uint32_t fit_bin = (size & (size - 1)) ? bin + 1 : bin;
+    uint32_t candidates = fit_bin < MM_MAX_FREE_BINS ? vm_page_family->free_bins_bitmap & (~0u << fit_bin) : 0;
+
+    if(candidates){
+
+        return glthread_to_meta_block(vm_page_family->free_bins[__builtin_ctz(candidates)].right);
+    }
+
+    if(vm_page_family->free_bins_bitmap & (1u << bin)){
+
+        uint32_t scan = 0;
+        glthread_node_t* node = vm_page_family->free_bins[bin].right;
+
+        for(; node && scan < MM_BIN_SCAN_LIMIT; node = node->right, scan++){
+
+            if(MM_META_BLK_SIZE(glthread_to_meta_block(node)) >= size){
+
+                return glthread_to_meta_block(node);
+            }
+        }
+    }
+
+    return NULL;
+#else
+    glthread_node_t* biggest_free_blk = vm_page_family->free_blks_pq.right;
+
+    if(biggest_free_blk && MM_META_BLK_SIZE(glthread_to_meta_block(biggest_free_blk)) >= size){
+
+        return glthread_to_meta_block(biggest_free_blk);
+    }
+
+    return NULL;
+#endif
+}
+
+
+/**
+ * mark a free meta block that is off the free block list as being Allocated for 'size' bytes,
+ * what is left over becomes a free block or internal fragmentation
+ */ 
+static void mm_split_data_block(vm_page_family_t* page_family, meta_blk_t* meta_blk, uint32_t size){
+
+    uint32_t remaining_size = MM_META_BLK_SIZE(meta_blk) - size;
+    meta_blk_t* remaining_blk = NULL;
+    meta_blk->size_and_free = size;
+
+    mm_count_allocated_block(page_family, size, remaining_size < META_SIZE + MM_MIN_DATA_BLK_SIZE ? remaining_size : 0);
+
+    if(remaining_size == 0){ // no split
+
+        #if MM_DEBUG
+            printf("Split: no split\n");
+        #endif
+
+        MM_COUNT_SPLIT(page_family, MM_SPLIT_NONE);
+    }else if(remaining_size >= META_SIZE + MM_MIN_DATA_BLK_SIZE &&
+             remaining_size < META_SIZE + page_family->struct_size){ // partial split: Soft Internal Fragmentation
+
+        #if MM_DEBUG
+            printf("Split: partial split(Soft IF)\n");
+        #endif
+
+        MM_COUNT_SPLIT(page_family, MM_SPLIT_SOFT_IF);
+
+        remaining_blk = NEXT_META_BLOCK_BY_SIZE(meta_blk);
+        remaining_blk->size_and_free = (remaining_size - META_SIZE) | MM_META_BLK_FREE;
+        mm_add_free_meta_block_to_free_block_list(page_family, remaining_blk);
+        MM_BIND_BLKS_FOR_ALLOCATION(meta_blk, remaining_blk);
+    }else if(remaining_size < META_SIZE + MM_MIN_DATA_BLK_SIZE){ // partial split: Hard Internal Fragmentation
+
+        #if MM_DEBUG
             printf("Split: partial split(Hard IF)\n");
         #endif
-    }else{ // full split
+
+        MM_COUNT_SPLIT(page_family, MM_SPLIT_HARD_IF);
+    }else{ // full split
+
+        #if MM_DEBUG
+            printf("Split: full split\n");
+        #endif
+
+        MM_COUNT_SPLIT(page_family, MM_SPLIT_FULL);
+
+        remaining_blk = NEXT_META_BLOCK_BY_SIZE(meta_blk);
+        remaining_blk->size_and_free = (remaining_size - META_SIZE) | MM_META_BLK_FREE;
+        mm_add_free_meta_block_to_free_block_list(page_family, remaining_blk);
+        MM_BIND_BLKS_FOR_ALLOCATION(meta_blk, remaining_blk);
+    }
+}
+
+
+/* 
+ * mark meta block as being Allocated for 'size' bytes of application data
+ * return MM_TRUE if allocation successed
+ * return MM_FALSE if the allocation failed 
+ */ 
+static vm_bool_t mm_split_free_data_block_for_allocation(vm_page_family_t* page_family, meta_blk_t* meta_blk, uint32_t size){
+
+    assert(page_family);
+    assert(MM_META_BLK_IS_FREE(meta_blk) == MM_TRUE);
+
+    if(MM_META_BLK_SIZE(meta_blk) < size){
+
+        return MM_FALSE;
+    }
+
+    mm_remove_free_meta_block_from_free_block_list(page_family, meta_blk);
+    mm_split_data_block(page_family, meta_blk, size);
+
+    return MM_TRUE;
+}
+
+
+/**
+ * carve up to n blocks of 'size' bytes out of one free block in a single pass, the free block
+ * leaves the free block list once and only the last split can put a remainder back,
+ * return the number of blocks carved
+ */ 
+static uint32_t mm_split_free_data_block_for_batch(vm_page_family_t* page_family, meta_blk_t* meta_blk,
+                                                   uint32_t size, uint32_t n, void** out_ptrs){
+
+    uint32_t count = 1;
+    meta_blk_t* next_blk = NULL;
+
+    assert(MM_META_BLK_IS_FREE(meta_blk) == MM_TRUE && MM_META_BLK_SIZE(meta_blk) >= size);
+
+    mm_remove_free_meta_block_from_free_block_list(page_family, meta_blk);
+
+    for(; count < n && MM_META_BLK_SIZE(meta_blk) >= 2 * size + META_SIZE; count++){
+
+        next_blk = (meta_blk_t*)((uint8_t*)(meta_blk + 1) + size);
+        next_blk->size_and_free = (MM_META_BLK_SIZE(meta_blk) - size - META_SIZE) | MM_META_BLK_FREE;
+        meta_blk->size_and_free = size;
+        MM_BIND_BLKS_FOR_ALLOCATION(meta_blk, next_blk);
+        mm_count_allocated_block(page_family, size, 0);
+        MM_COUNT_SPLIT(page_family, MM_SPLIT_FULL);
+
+        *out_ptrs++ = meta_blk + 1;
+        meta_blk = next_blk;
+    }
+
+    mm_split_data_block(page_family, meta_blk, size);
+    *out_ptrs = meta_blk + 1;
+
+    return count;
+}
+
+
+#if MM_QUICK_LIST_MAX_SIZE
+/**
+ * take a block of exactly 'size' data bytes off the quick lists, it never left the allocated state
+ */ 
+static meta_blk_t* mm_quick_list_pop(vm_page_family_t* vm_page_family, uint32_t size){
+
+    uint32_t index = size / MM_DATA_BLK_ALIGN;
+    meta_blk_t* meta_blk = NULL;
+
+    if(size > MM_QUICK_LIST_MAX_SIZE || (meta_blk = vm_page_family->quick_lists[index]) == NULL){
+
+        return NULL;
+    }
+
+    vm_page_family->quick_lists[index] = MM_QUICK_LIST_NEXT(meta_blk);
+    MM_META_BLK_SET_QUICK(meta_blk, MM_FALSE);
+    --vm_page_family->quick_counts[index];
+    --vm_page_family->quick_block_count;
+    --((vm_page_t*)MM_GET_PAGE_FROM_META_BLOCK(meta_blk))->quick_blocks;
+
+    MM_COUNTER_SUB(vm_page_family, free_blocks, 1);
+    mm_count_allocated_block(vm_page_family, size, mm_block_hard_IF(meta_blk));
+
+    return meta_blk;
+}
+#endif
+
+
+/**
+ * return meta block of free data block, a block of the exact size waiting on the quick lists goes first
+ */ 
+static meta_blk_t* mm_allocate_free_data_block(vm_page_family_t* page_family, uint32_t size){
+
+    vm_bool_t status = MM_FALSE;
+    vm_page_t* vm_page = NULL;
+    meta_blk_t* bf_meta_blk = NULL;
+
+#if MM_QUICK_LIST_MAX_SIZE
+    if((bf_meta_blk = mm_quick_list_pop(page_family, size)) != NULL){
+
+        return bf_meta_blk;
+    }
+#endif
+
+    bf_meta_blk = mm_get_free_block_page_family(page_family, size);
+
+    if(!bf_meta_blk){
+
+        #if MM_DEBUG
+            printf("request new VM Page!\n");
+        #endif
+
+        vm_page = mm_family_add_new_page(page_family);
+
+        if(vm_page == NULL){
+
+            return NULL;
+        }
+
+        status = mm_split_free_data_block_for_allocation(page_family, &vm_page->meta_blk, size);
+
+        if(status){
+
+            return &vm_page->meta_blk;
+        }
+
+        return NULL;
+    }
+
+    status = mm_split_free_data_block_for_allocation(page_family, bf_meta_blk, size);
+
+    if(status){
+
+        return bf_meta_blk;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * return meta block of a free data block whose data starts on an 'alignment' boundary, the
+ * padding in front of it stays a free block of its own
+ */ 
+static meta_blk_t* mm_allocate_aligned_free_data_block(vm_page_family_t* page_family, uint32_t size, uint32_t alignment){
+
+    vm_page_t* vm_page = NULL;
+    meta_blk_t* free_blk = mm_get_free_block_page_family(page_family, size + alignment + META_SIZE + MM_MIN_DATA_BLK_SIZE);
+    meta_blk_t* aligned_blk = NULL;
+    uint8_t* data_blk = NULL;
+    uint8_t* aligned_data_blk = NULL;
+    uint32_t padding = 0;
+
+    if(!free_blk){
+
+        if((vm_page = mm_family_add_new_page(page_family)) == NULL){
+
+            return NULL;
+        }
+
+        free_blk = &vm_page->meta_blk;
+    }
+
+    mm_remove_free_meta_block_from_free_block_list(page_family, free_blk);
+
+    data_blk = (uint8_t*)(free_blk + 1);
+    aligned_data_blk = (uint8_t*)MM_ALIGN_UP((uintptr_t)data_blk, alignment);
+
+    if(aligned_data_blk != data_blk){
+
+        /* the padding has to be able to hold a free block */
+        while(aligned_data_blk - data_blk < (intptr_t)(META_SIZE + MM_MIN_DATA_BLK_SIZE)){
+
+            aligned_data_blk += alignment;
+        }
+
+        padding = (uint32_t)(aligned_data_blk - data_blk);
+        aligned_blk = (meta_blk_t*)aligned_data_blk - 1;
+        aligned_blk->size_and_free = (MM_META_BLK_SIZE(free_blk) - padding) | MM_META_BLK_FREE;
+        MM_META_BLK_SET_SIZE(free_blk, padding - META_SIZE);
+        MM_BIND_BLKS_FOR_ALLOCATION(free_blk, aligned_blk);
+        mm_add_free_meta_block_to_free_block_list(page_family, free_blk);
+
+        free_blk = aligned_blk;
+    }
+
+    mm_split_data_block(page_family, free_blk, size);
+
+    return free_blk;
+}
+
+
+/**
+ * map a dedicated multi-page VM page for an object that does not fit into one system page,
+ * the whole span is a single allocated block and is never added to the free block list
+ */ 
+static meta_blk_t* mm_allocate_large_data_block(vm_page_family_t* page_family, uint32_t size){
+
+    /* an aligned object can be too large for a page with its padding only, it still gets a large VM page */
+    uint32_t units = mm_large_object_page_units(size) < 2 ? 2 : mm_large_object_page_units(size);
+    vm_page_t* vm_page = allocate_vm_page(page_family, units);
+
+    if(vm_page == NULL){
+
+        return NULL;
+    }
+
+    #if MM_DEBUG
+        printf("Large object: %u bytes in %u pages\n", size, units);
+    #endif
+
+    vm_page->meta_blk.size_and_free = size;
+    mm_count_allocated_block(page_family, size, mm_max_page_allocatable_memory(units) - size);
+
+    return &vm_page->meta_blk;
+}
+
+
+/**
+ * 
+ */ 
+static meta_blk_t* mm_free_blocks(meta_blk_t* free_meta_blk){
+
+    MM_META_BLK_SET_FREE(free_meta_blk, MM_TRUE);
+    meta_blk_t* next_meta_blk = NEXT_META_BLOCK(free_meta_blk);
+    meta_blk_t* pre_meta_blk = PREV_META_BLOCK(free_meta_blk);
+    meta_blk_t* ret = free_meta_blk;
+    vm_page_t* vm_page = MM_GET_PAGE_FROM_META_BLOCK(free_meta_blk);
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+
+    /* not linked yet, but the data area held application data */
+    glthread_init(MM_META_BLK_GLUE(free_meta_blk));
+
+    uint64_t hard_IF = mm_block_hard_IF(free_meta_blk);
+
+    mm_count_freed_block(vm_page_family, MM_META_BLK_SIZE(free_meta_blk), hard_IF);
+    MM_META_BLK_SET_SIZE(free_meta_blk, MM_META_BLK_SIZE(free_meta_blk) + hard_IF);
+
+    if(next_meta_blk && MM_META_BLK_IS_FREE(next_meta_blk) == MM_TRUE){
+ 
+        mm_union_free_blocks(vm_page_family, free_meta_blk, next_meta_blk);
+    }
+
+    if(pre_meta_blk && MM_META_BLK_IS_FREE(pre_meta_blk) == MM_TRUE){
+
+        mm_union_free_blocks(vm_page_family, pre_meta_blk, free_meta_blk);
+        ret = pre_meta_blk;
+    }
+
+    if(mm_vm_page_is_empty(vm_page)){
+
+        mm_page_delete_and_free(vm_page);
+        return NULL;
+    }
+
+    mm_add_free_meta_block_to_free_block_list(vm_page_family, ret);
+
+    return ret;
+}
+
+
+/**
+ * coalesce all free blocks of a VM page in one walk, every run of free blocks goes back to the
+ * free block list once, the page goes back to the page cache if nothing is left allocated
+ */ 
+static void mm_free_vm_page_blocks(vm_page_t* vm_page){
+
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+    uint8_t* top_of_vm_page = (uint8_t*)vm_page + SYSTEM_PAGE_SIZE;
+    meta_blk_t* meta_blk = &vm_page->meta_blk;
+    meta_blk_t* free_blk = NULL;
+
+    while(meta_blk){
+
+        if(MM_META_BLK_IS_FREE(meta_blk) == MM_FALSE){
+
+            meta_blk = NEXT_META_BLOCK(meta_blk);
+            continue;
+        }
+
+        /* blocks freed by the caller are not on the free block list, removing them is a no-op */
+        free_blk = meta_blk;
+        while(meta_blk && MM_META_BLK_IS_FREE(meta_blk) == MM_TRUE){
+
+            mm_remove_free_meta_block_from_free_block_list(vm_page_family, meta_blk);
+            meta_blk = NEXT_META_BLOCK(meta_blk);
+        }
+
+        if(free_blk == &vm_page->meta_blk && meta_blk == NULL){
+
+            mm_page_delete_and_free(vm_page);
+            return;
+        }
+
+        /* the run also takes the hard internal fragmentation up to the next allocated block */
+        MM_META_BLK_SET_SIZE(free_blk, (meta_blk ? (uint8_t*)meta_blk : top_of_vm_page) - (uint8_t*)(free_blk + 1));
+        free_blk->next_offset = meta_blk ? MM_META_BLK_OFFSET(meta_blk) : 0;
+        if(meta_blk){
+
+            meta_blk->pre_offset = MM_META_BLK_OFFSET(free_blk);
+        }
+
+        mm_add_free_meta_block_to_free_block_list(vm_page_family, free_blk);
+    }
+}
+
+
+/**
+ * work out how many slots of a MM_FAMILY_SLAB family fit into a system page next to their
+ * occupancy bitmap, a family whose struct does not fit into a page loses the attribute
+ */ 
+static void mm_slab_init_geometry(vm_page_family_t* vm_page_family){
+
+    /* a freed slot holds a link, a slot on a remote free list a link and the remote free mark */
+    uint32_t slot_size = vm_page_family->struct_size < MM_MIN_SLAB_SLOT_SIZE ? MM_MIN_SLAB_SLOT_SIZE : vm_page_family->struct_size;
+    uint32_t alignment = MM_FAMILY_ALIGNMENT(vm_page_family) < 8 ? 8 : MM_FAMILY_ALIGNMENT(vm_page_family);
+    uint32_t data_offset = offset_of(vm_page_t, page_data_blk);
+    uint32_t count = 0;
+
+    /* slots stay 8 byte aligned and aligned to the family alignment */
+    slot_size = MM_ALIGN_UP(slot_size, alignment);
+    count = ((uint32_t)SYSTEM_PAGE_SIZE - data_offset) / slot_size;
+
+    while(count && MM_ALIGN_UP(data_offset + ((count + 63) / 64) * sizeof(uint64_t), alignment) + count * slot_size > SYSTEM_PAGE_SIZE){
+
+        --count;
+    }
+
+    vm_page_family->slab_slot_size = slot_size;
+    vm_page_family->slab_obj_count = count;
+    vm_page_family->slab_obj_offset = MM_ALIGN_UP(data_offset + ((count + 63) / 64) * sizeof(uint64_t), alignment);
+    glthread_init(&vm_page_family->slab_partial_pages);
+
+    if(count == 0){
+
+        vm_page_family->flags &= ~MM_FAMILY_SLAB;
+    }
+}
+
+
+/**
+ * turn a new VM page into a slab page with every slot free
+ */ 
+static vm_page_t* mm_slab_add_new_page(vm_page_family_t* vm_page_family){
+
+    vm_page_t* vm_page = allocate_vm_page(vm_page_family, 1);
+
+    if(vm_page == NULL){
+
+        return NULL;
+    }
+
+    uint64_t* free_map = MM_SLAB_FREE_MAP(vm_page);
+    uint32_t count = vm_page_family->slab_obj_count;
+
+    vm_page->page_type = MM_VM_PAGE_SLAB;
+    vm_page->slab_free_count = count;
+    MM_COUNTER_ADD(vm_page_family, free_blocks, count);
+
+    for(uint32_t i=0; i<count/64; i++){
+
+        free_map[i] = ~0ull;
+    }
+
+    if(count % 64){
+
+        free_map[count / 64] = (1ull << (count % 64)) - 1;
+    }
+
+    MM_MARK_VM_PAGE_DIRTY(vm_page, (uint8_t*)vm_page + vm_page_family->slab_obj_offset);
+
+    glthread_init(&vm_page->slab_glue);
+    glthread_add(&vm_page_family->slab_partial_pages, &vm_page->slab_glue);
+
+    return vm_page;
+}
+
+
+/**
+ * take a slot of a partial slab page with a bit scan of its occupancy bitmap
+ */ 
+static void* mm_slab_allocate(vm_page_family_t* vm_page_family, vm_page_t** slab_page){
+
+    glthread_node_t* node = vm_page_family->slab_partial_pages.right;
+    vm_page_t* vm_page = node ? glthread_to_slab_page(node) : mm_slab_add_new_page(vm_page_family);
+
+    if(vm_page == NULL){
+
+        return NULL;
+    }
+
+    uint64_t* free_map = MM_SLAB_FREE_MAP(vm_page);
+    uint32_t slot = 0;
+
+    while(free_map[slot / 64] == 0){
+
+        slot += 64;
+    }
+
+    slot += __builtin_ctzll(free_map[slot / 64]);
+    free_map[slot / 64] &= ~(1ull << (slot % 64));
+
+    /* a full slab page leaves the partial list */
+    if(--vm_page->slab_free_count == 0){
+
+        glthread_remove(&vm_page->slab_glue);
+    }
+
+    MM_COUNTER_SUB(vm_page_family, free_blocks, 1);
+    mm_count_allocated_block(vm_page_family, vm_page_family->struct_size, vm_page_family->slab_slot_size - vm_page_family->struct_size);
+
+    *slab_page = vm_page;
+
+    return (uint8_t*)vm_page + vm_page_family->slab_obj_offset + slot * vm_page_family->slab_slot_size;
+}
+
+
+/**
+ * give a slot back to its slab page, an empty slab page is released
+ */ 
+static void mm_slab_free(vm_page_t* vm_page, void* addr){
+
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+    uint32_t slot = (uint32_t)(((uint8_t*)addr - (uint8_t*)vm_page - vm_page_family->slab_obj_offset) / vm_page_family->slab_slot_size);
+    uint64_t* free_map = MM_SLAB_FREE_MAP(vm_page);
+
+    assert(!(free_map[slot / 64] & (1ull << (slot % 64))));
+    free_map[slot / 64] |= 1ull << (slot % 64);
+
+    MM_COUNTER_ADD(vm_page_family, free_blocks, 1);
+    mm_count_freed_block(vm_page_family, vm_page_family->struct_size, vm_page_family->slab_slot_size - vm_page_family->struct_size);
+
+    /* a full slab page that gets a free slot joins the partial list again */
+    if(vm_page->slab_free_count++ == 0){
+
+        glthread_add(&vm_page_family->slab_partial_pages, &vm_page->slab_glue);
+    }
+
+    if(vm_page->slab_free_count == vm_page_family->slab_obj_count){
+
+        glthread_remove(&vm_page->slab_glue);
+        MM_COUNTER_SUB(vm_page_family, free_blocks, vm_page_family->slab_obj_count);
+        mm_page_delete_and_free(vm_page);
+    }
+}
+
+
+#if MM_QUICK_LIST_MAX_SIZE
+/**
+ * coalesce the blocks of a quick list back into the free block lists
+ */ 
+static void mm_quick_list_drain(vm_page_family_t* vm_page_family, uint32_t index){
+
+    meta_blk_t* meta_blk = vm_page_family->quick_lists[index];
+    meta_blk_t* next_blk = NULL;
+
+    vm_page_family->quick_lists[index] = NULL;
+    vm_page_family->quick_block_count -= vm_page_family->quick_counts[index];
+    vm_page_family->quick_counts[index] = 0;
+
+    /* a VM page only goes away with its last quick block, the next ones live in other pages */
+    for(; meta_blk; meta_blk = next_blk){
+
+        next_blk = MM_QUICK_LIST_NEXT(meta_blk);
+        MM_META_BLK_SET_QUICK(meta_blk, MM_FALSE);
+        --((vm_page_t*)MM_GET_PAGE_FROM_META_BLOCK(meta_blk))->quick_blocks;
+
+        MM_COUNTER_SUB(vm_page_family, free_blocks, 1);
+        mm_count_allocated_block(vm_page_family, MM_META_BLK_SIZE(meta_blk), mm_block_hard_IF(meta_blk));
+        mm_free_blocks(meta_blk);
+    }
+}
+
+
+/**
+ * coalesce every quick list of a page family
+ */ 
+static void mm_quick_lists_drain(vm_page_family_t* vm_page_family){
+
+    for(uint32_t index = 0; vm_page_family->quick_block_count && index < MM_QUICK_LISTS; index++){
+
+        if(vm_page_family->quick_lists[index]){
+
+            mm_quick_list_drain(vm_page_family, index);
+        }
+    }
+}
+
+
+/**
+ * free a block of a meta block page: a small block waits on the quick list of its size without
+ * coalescing, the quick lists are coalesced once one of them is full or they hold the last blocks of a page
+ */ 
+static void mm_quick_list_free(vm_page_t* vm_page, meta_blk_t* free_blk){
+
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+    uint32_t size = MM_META_BLK_SIZE(free_blk);
+    uint32_t index = size / MM_DATA_BLK_ALIGN;
+    uint16_t quick_blocks = vm_page->quick_blocks;
+
+    if(--vm_page->live_blocks == 0){
+
+        /* nothing of the page is in use anymore, the page must be able to go back to the page cache,
+         * it may be released by the free so it is not touched after it */
+        mm_free_blocks(free_blk);
+        if(quick_blocks){
+
+            mm_quick_lists_drain(vm_page_family);
+        }
+        return;
+    }
+
+    if(size > MM_QUICK_LIST_MAX_SIZE){
+
+        mm_free_blocks(free_blk);
+        return;
+    }
+
+    if(vm_page_family->quick_counts[index] == MM_QUICK_LIST_DEPTH){
+
+        mm_quick_list_drain(vm_page_family, index);
+    }
+
+    mm_count_freed_block(vm_page_family, size, mm_block_hard_IF(free_blk));
+    MM_COUNTER_ADD(vm_page_family, free_blocks, 1);
+
+    MM_META_BLK_SET_QUICK(free_blk, MM_TRUE);
+    MM_QUICK_LIST_NEXT(free_blk) = vm_page_family->quick_lists[index];
+    vm_page_family->quick_lists[index] = free_blk;
+    ++vm_page_family->quick_counts[index];
+    ++vm_page_family->quick_block_count;
+    ++vm_page->quick_blocks;
+}
+#endif
+
+
+/**
+ * return the slot of a slab page object at addr, or slab_obj_count when addr is no slot start
+ */ 
+static inline uint32_t mm_slab_slot(vm_page_t* vm_page, const void* addr){
+
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+    uintptr_t offset = (uintptr_t)addr - (uintptr_t)vm_page;
+
+    if(offset < vm_page_family->slab_obj_offset || (offset - vm_page_family->slab_obj_offset) % vm_page_family->slab_slot_size){
+
+        return vm_page_family->slab_obj_count;
+    }
+
+    offset = (offset - vm_page_family->slab_obj_offset) / vm_page_family->slab_slot_size;
+
+    return offset < vm_page_family->slab_obj_count ? (uint32_t)offset : vm_page_family->slab_obj_count;
+}
+
+
+/**
+ * can the meta block in front of addr be a block of its meta block page: its neighbours must link back to it.
+ * Only the owner thread of the page walks the links
+ */ 
+static vm_bool_t mm_meta_blk_is_linked(vm_page_t* vm_page, meta_blk_t* meta_blk){
+
+    uint32_t first = MM_META_BLK_OFFSET(&vm_page->meta_blk);
+    uint32_t offset = MM_META_BLK_OFFSET(meta_blk);
+
+    if(meta_blk == &vm_page->meta_blk){
+
+        return meta_blk->pre_offset == 0 ? MM_TRUE : MM_FALSE;
+    }
+
+    if(meta_blk->pre_offset < first || meta_blk->pre_offset >= offset || PREV_META_BLOCK(meta_blk)->next_offset != offset){
+
+        return MM_FALSE;
+    }
+
+    if(meta_blk->next_offset && (meta_blk->next_offset <= offset || meta_blk->next_offset > SYSTEM_PAGE_SIZE - META_SIZE ||
+       NEXT_META_BLOCK(meta_blk)->pre_offset != offset)){
+
+        return MM_FALSE;
+    }
+
+    return MM_TRUE;
+}
+
+
+/**
+ * is addr an allocated object of its VM page: the start of a slab slot in use, of a large object or of
+ * an allocated meta block with consistent links. Catches interior and stale pointers and double frees,
+ * called by the owner thread of the page only
+ */ 
+static vm_bool_t mm_is_allocated_object(vm_page_t* vm_page, const void* addr){
+
+    uint32_t slot = 0;
+    meta_blk_t* meta_blk = NULL;
+
+    if(vm_page->page_type == MM_VM_PAGE_SLAB){
+
+        if((slot = mm_slab_slot(vm_page, addr)) == vm_page->page_family->slab_obj_count){
+
+            return MM_FALSE;
+        }
+
+        return (MM_SLAB_FREE_MAP(vm_page)[slot / 64] & (1ull << (slot % 64))) ? MM_FALSE : MM_TRUE;
+    }
+
+    /* an aligned large object does not start right behind its meta block */
+    meta_blk = MM_IS_LARGE_VM_PAGE(vm_page) ? &vm_page->meta_blk : GET_META_BLK(addr);
+
+    /* a block waiting on a quick list was freed already */
+    if(MM_META_BLK_IS_FREE(meta_blk) || MM_META_BLK_IS_QUICK(meta_blk)){
+
+        return MM_FALSE;
+    }
+
+    if(MM_IS_LARGE_VM_PAGE(vm_page) ? (uint8_t*)addr != (uint8_t*)vm_page + vm_page->large_obj_offset :
+       mm_meta_blk_is_linked(vm_page, meta_blk) == MM_FALSE){
+
+        return MM_FALSE;
+    }
+
+#if MM_THREAD_SAFE
+    /* another thread has handed it to the remote free list of the heap already */
+    return MM_REMOTE_FREE_MARKED(vm_page->page_family->heap, addr) ? MM_FALSE : MM_TRUE;
+#else
+    return MM_TRUE;
+#endif
+}
+
+
+#if MM_THREAD_SAFE
+/**
+ * the part of mm_is_allocated_object() a thread that does not own the page can check without racing
+ * the owner: the slab slot geometry or the large object offset, the state word of a meta block, which
+ * the owner does not write while the block is allocated, and the remote free mark. The owner checks
+ * the rest when it frees the object
+ */ 
+static vm_bool_t mm_is_remote_object(vm_page_t* vm_page, const void* addr){
+
+    if(vm_page->page_type == MM_VM_PAGE_SLAB){
+
+        if(mm_slab_slot(vm_page, addr) == vm_page->page_family->slab_obj_count){
+
+            return MM_FALSE;
+        }
+    }else if(MM_IS_LARGE_VM_PAGE(vm_page)){
+
+        if((uint8_t*)addr != (uint8_t*)vm_page + vm_page->large_obj_offset){
+
+            return MM_FALSE;
+        }
+    }else if(((uintptr_t)addr & (SYSTEM_PAGE_SIZE - 1)) > SYSTEM_PAGE_SIZE - MM_MIN_DATA_BLK_SIZE ||
+             (__atomic_load_n(&((meta_blk_t*)GET_META_BLK(addr))->size_and_free, __ATOMIC_RELAXED) & (MM_META_BLK_FREE | MM_META_BLK_QUICK))){
+
+        return MM_FALSE;
+    }
+
+    return MM_REMOTE_FREE_MARKED(vm_page->page_family->heap, addr) ? MM_FALSE : MM_TRUE;
+}
+#endif
+
+
+/**
+ * free an object that belongs to the calling thread, anything but an allocated object is ignored
+ */ 
+static void mm_free_local(vm_page_t* vm_page, void* addr){
+
+    if(mm_is_allocated_object(vm_page, addr) == MM_FALSE){
+
+        #if MM_DEBUG
+            printf("zfree: %p is not an allocated object, double free?\n", addr);
+        #endif
+        return;
+    }
+
+    if(vm_page->page_type == MM_VM_PAGE_SLAB){
+
+        mm_slab_free(vm_page, addr);
+        return;
+    }
+
+    /* an aligned large object does not start right behind its meta block */
+    meta_blk_t* free_blk = MM_IS_LARGE_VM_PAGE(vm_page) ? &vm_page->meta_blk : GET_META_BLK(addr);
+
+#if MM_QUICK_LIST_MAX_SIZE
+    if(!MM_IS_LARGE_VM_PAGE(vm_page)){
+
+        mm_quick_list_free(vm_page, free_blk);
+        return;
+    }
+#endif
+
+    mm_free_blocks(free_blk);
+}
+
+
+#if MM_THREAD_SAFE
+/**
+ * free the objects other threads have handed to the heap, called by the owner thread only.
+ * The whole list is taken with one exchange, pushers never wait for the owner
+ */ 
+static void mm_heap_drain_remote_frees(mm_heap_t* heap){
+
+    void* addr = __atomic_exchange_n(&heap->remote_free_list, NULL, __ATOMIC_ACQUIRE);
+
+    while(addr){
+
+        void* next = *(void**)addr;
+
+        ((uintptr_t*)addr)[1] = 0;
+        mm_free_local(MM_GET_PAGE_FROM_ADDR(addr), addr);
+        addr = next;
+    }
+}
+
+
+/**
+ * hand a chain of objects linked through their first word and marked with MM_REMOTE_FREE_MARK(), first to last,
+ * to the heap that owns their VM pages, the owner thread frees them later. Lock free: many threads push, only the owner
+ * takes the list as a whole, so a pushed head is never popped alone and the CAS cannot suffer ABA
+ */ 
+static void mm_heap_push_remote_frees(mm_heap_t* heap, void* first, void* last){
+
+    void* head = __atomic_load_n(&heap->remote_free_list, __ATOMIC_RELAXED);
+
+    do{
+
+        *(void**)last = head;
+    }while(!__atomic_compare_exchange_n(&heap->remote_free_list, &head, first, MM_TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+/**
+ * thread exit: give the heap up so that a new thread can adopt its VM pages
+ */ 
+static void mm_heap_release(void* arg){
+
+    mm_heap_t* heap = (mm_heap_t*)arg;
+
+    mm_heap_drain_remote_frees(heap);
+
+    pthread_mutex_lock(&mm_heap_list_lock);
+    heap->in_use = MM_FALSE;
+    pthread_mutex_unlock(&mm_heap_list_lock);
+}
+
+
+static void mm_heap_key_create(void){
+
+    pthread_key_create(&mm_heap_key, mm_heap_release);
+}
+
+
+/**
+ * return the heap of the calling thread, adopt an abandoned heap or map a new one
+ */ 
+static mm_heap_t* mm_get_thread_heap(void){
+
+    if(mm_thread_heap){
+
+        return mm_thread_heap;
+    }
+
+    pthread_once(&mm_heap_key_once, mm_heap_key_create);
+
+    mm_heap_t* heap = NULL;
+
+    pthread_mutex_lock(&mm_heap_list_lock);
+
+    for(heap = first_heap; heap; heap = heap->next){
+
+        if(heap->in_use == MM_FALSE){
+
+            break;
+        }
+    }
+
+    if(heap == NULL){
+
+        heap = mm_get_vm_page((sizeof(mm_heap_t) + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+
+        if(heap){
+
+            heap->next = first_heap;
+            first_heap = heap;
+        }
+    }
+
+    if(heap){
+
+        heap->in_use = MM_TRUE;
+    }
+
+    pthread_mutex_unlock(&mm_heap_list_lock);
+
+    if(heap == NULL){
+
+        #if MM_DEBUG
+            printf("Fail to create thread heap!\n");
+        #endif
+
+        return NULL;
+    }
+
+    pthread_setspecific(mm_heap_key, heap);
+    mm_thread_heap = heap;
+
+    return heap;
+}
+
+
+/**
+ * return the heap's copy of a registered page family, created on first use
+ */ 
+static vm_page_family_t* mm_heap_get_family(mm_heap_t* heap, vm_page_family_t* vm_page_family){
+
+    uint32_t chunk = vm_page_family->family_id / MM_HEAP_FAMILIES_PER_CHUNK;
+    uint32_t slot = vm_page_family->family_id % MM_HEAP_FAMILIES_PER_CHUNK;
+
+    if(chunk >= MM_HEAP_MAX_FAMILY_CHUNKS){
+
+        return NULL;
+    }
+
+    vm_page_family_t** families = heap->families[chunk];
+
+    if(families == NULL){
+
+        families = mm_get_vm_page((MM_HEAP_FAMILIES_PER_CHUNK * sizeof(vm_page_family_t*) + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+
+        if(families == NULL){
+
+            return NULL;
+        }
+
+        __atomic_store_n(&heap->families[chunk], families, __ATOMIC_RELEASE);
+    }
+
+    vm_page_family_t* local_family = families[slot];
+
+    if(local_family){
+
+        return local_family;
+    }
+
+    if(heap->family_space < sizeof(vm_page_family_t)){
+
+        if((heap->family_cursor = mm_get_vm_page(1)) == NULL){
+
+            heap->family_space = 0;
+            return NULL;
+        }
+        heap->family_space = SYSTEM_PAGE_SIZE;
+    }
+
+    local_family = (vm_page_family_t*)heap->family_cursor;
+    heap->family_cursor += sizeof(vm_page_family_t);
+    heap->family_space -= sizeof(vm_page_family_t);
+
+    strncpy(local_family->struct_name, vm_page_family->struct_name, MAX_NAME_LEN);
+    local_family->name_hash = vm_page_family->name_hash;
+    local_family->struct_size = vm_page_family->struct_size;
+    local_family->flags = vm_page_family->flags;
+    local_family->family_id = vm_page_family->family_id;
+    local_family->heap = heap;
+    local_family->reg_family = vm_page_family;
+    local_family->first_page = NULL;
+    local_family->slab_slot_size = vm_page_family->slab_slot_size;
+    local_family->slab_obj_count = vm_page_family->slab_obj_count;
+    local_family->slab_obj_offset = vm_page_family->slab_obj_offset;
+    glthread_init(&local_family->slab_partial_pages);
+    memset(&local_family->counters, 0x0, sizeof(mm_family_counters_t));
+#if MM_QUOTAS
+    local_family->quota_reserved = 0;
+#endif
+#if MM_LATENCY_HIST
+    memset(&local_family->latency, 0x0, sizeof(mm_latency_stats_t));
+#endif
+    mm_init_free_block_list(local_family);
+
+    __atomic_store_n(&families[slot], local_family, __ATOMIC_RELEASE);
+
+    return local_family;
+}
+#endif
+
+
+/**
+ * return the page family the calling thread allocates from
+ */ 
+static inline vm_page_family_t* mm_get_local_page_family(vm_page_family_t* vm_page_family){
+
+#if MM_THREAD_SAFE
+    mm_heap_t* heap = mm_get_thread_heap();
+
+    if(heap == NULL){
+
+        return NULL;
+    }
+
+    if(__atomic_load_n(&heap->remote_free_list, __ATOMIC_RELAXED)){
+
+        mm_heap_drain_remote_frees(heap);
+    }
+
+    return mm_heap_get_family(heap, vm_page_family);
+#else
+    return vm_page_family;
+#endif
+}
+
+
+/**
+ * print all meta blocks in the vm page, return the number of system pages in use
+ */ 
+static uint32_t mm_print_meta_block_usage(vm_page_family_t* current_family){
+
+    uint32_t page_count = 0, system_page_count = 0;
+
+    if(current_family == NULL){
+
+        return system_page_count;
+    }
+
+    vm_page_t* vm_page = current_family->first_page;
+
+    if(vm_page == NULL && current_family->cached_page_count == 0){
+
+        return system_page_count;
+    }
+
+    printf("Struct Name: %s, Struct Size: %d\n", current_family->struct_name, current_family->struct_size);
+
+    meta_blk_t* meta_blk = NULL;
+    vm_page_t* vm_page_ptr = vm_page;
+    uint32_t meta_data_size = current_family->struct_size + META_SIZE;
+
+    while(vm_page_ptr){
+
+        uint32_t block_counter = 1;
+        uint32_t OBC = 0, FBC = 0;
+
+        system_page_count += vm_page_ptr->page_units;
+
+        if(MM_IS_LARGE_VM_PAGE(vm_page_ptr)){
+
+            printf(ANSI_COLOR_MAGENTA "\nVM Page: %u (large object, %u pages)\n" ANSI_COLOR_RESET,
+                    ++page_count, vm_page_ptr->page_units);
+        }else{
+
+            printf(ANSI_COLOR_MAGENTA "\nVM Page: %u\n" ANSI_COLOR_RESET, ++page_count);
+        }
+        printf("\tpre page = %p, next page = %p\n", vm_page_ptr->pre_page, vm_page_ptr->next_page);
+
+        if(vm_page_ptr->page_type == MM_VM_PAGE_SLAB){
+
+            OBC = current_family->slab_obj_count - vm_page_ptr->slab_free_count;
+            printf("\t%-15sSlab slots: %-6u Allocated slots: %-6u Free slots: %-6u Memory in use: %-6u\n\n",
+                    current_family->struct_name, current_family->slab_obj_count, OBC,
+                    vm_page_ptr->slab_free_count, OBC * current_family->slab_slot_size);
+
+            vm_page_ptr = vm_page_ptr->next_page;
+            continue;
+        }
+
+        ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page_ptr, meta_blk)
+            printf(ANSI_COLOR_RED "\tBlock %d: %p" ANSI_COLOR_RESET, block_counter++, meta_blk);
+            printf(ANSI_COLOR_YELLOW "%s" ANSI_COLOR_RESET, MM_META_BLK_IS_FREE(meta_blk) ? " F R E E D " : " ALLOCATED ");
+            printf(ANSI_COLOR_BLUE "data_blk_size = %-6u offset = %-6u pre meta = %-14p next meta = %p\n" ANSI_COLOR_RESET,
+                    MM_META_BLK_SIZE(meta_blk), MM_META_BLK_OFFSET(meta_blk), (void*)PREV_META_BLOCK(meta_blk), (void*)NEXT_META_BLOCK(meta_blk));
+
+            OBC = MM_META_BLK_IS_FREE(meta_blk) ? OBC : OBC+1;
+            FBC = MM_META_BLK_IS_FREE(meta_blk) ? FBC+1 : FBC;
+        ITERATE_VM_PAGE_ALL_BLOCKS_END
+
+        if(MM_IS_LARGE_VM_PAGE(vm_page_ptr)){
+
+            printf("\t%-15sLarge object: %-6u Memory in use: %-6lu\n\n",
+                    current_family->struct_name, MM_META_BLK_SIZE(&vm_page_ptr->meta_blk), vm_page_ptr->page_units * SYSTEM_PAGE_SIZE);
+        }else{
+
+            printf("\t%-15sTotal blocks: %-6u Allocated blocks: %-6u Free blocks: %-6u Memory in use: %-6u\n\n",
+                    current_family->struct_name, OBC + FBC, OBC, FBC, OBC * meta_data_size);
+        }
+
+        vm_page_ptr = vm_page_ptr->next_page;
+    }
+
+    if(current_family->cached_page_count){
+
+        printf("\t%-15sRetained empty pages: %u\n\n", current_family->struct_name, current_family->cached_page_count);
+    }
+
+    return system_page_count;
+}
+
+
+/**
+ * FNV-1a hash of a struct_name, limited to the MAX_NAME_LEN - 1 characters a family keeps
+ */ 
+static uint32_t mm_struct_name_hash(const char* struct_name){
+
+    uint32_t hash = 2166136261u;
+
+    for(uint32_t i=0; i<MAX_NAME_LEN - 1 && struct_name[i]; i++){
+
+        hash ^= (uint8_t)struct_name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+/**
+ * return the slot of the name index that holds struct_name, or the empty slot it would take
+ */ 
+static uint32_t mm_family_name_index_slot(vm_page_family_t** index, uint32_t index_size, const char* struct_name, uint32_t hash){
+
+    uint32_t mask = index_size - 1;
+    uint32_t slot = hash & mask;
+
+    while(index[slot]){
+
+        if(index[slot]->name_hash == hash &&
+           strncmp(index[slot]->struct_name, struct_name, MAX_NAME_LEN - 1) == 0){
+
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+
+/**
+ * add a page family to the name index, the index is doubled when it gets half full
+ */ 
+static vm_bool_t mm_family_name_index_insert(vm_page_family_t* vm_page_family){
+
+    if((family_count + 1) * 2 > family_name_index_size){
+
+        uint32_t new_size = family_name_index_size ? family_name_index_size * 2 : SYSTEM_PAGE_SIZE / sizeof(vm_page_family_t*);
+        uint32_t units = (new_size * sizeof(vm_page_family_t*) + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE;
+        vm_page_family_t** new_index = mm_get_vm_page(units);
+
+        if(new_index == NULL){
+
+            return MM_FALSE;
+        }
+
+        for(uint32_t i=0; i<family_name_index_size; i++){
+
+            if(family_name_index[i]){
+
+                vm_page_family_t* family = family_name_index[i];
+                new_index[mm_family_name_index_slot(new_index, new_size, family->struct_name, family->name_hash)] = family;
+            }
+        }
+
+        if(family_name_index){
+
+            mm_release_vm_page(family_name_index,
+                    (family_name_index_size * sizeof(vm_page_family_t*) + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+        }
+
+        family_name_index = new_index;
+        family_name_index_size = new_size;
+    }
+
+    family_name_index[mm_family_name_index_slot(family_name_index, family_name_index_size,
+            vm_page_family->struct_name, vm_page_family->name_hash)] = vm_page_family;
+    __atomic_store_n(&family_count, family_count + 1, __ATOMIC_RELEASE);
+
+    return MM_TRUE;
+}
+
+
+/**
+ * chunk of the registry that holds family_id
+ */ 
+static inline uint32_t mm_family_chunk(uint32_t family_id){
+
+    return 31 - __builtin_clz(family_id + MM_FAMILY_CHUNK_BASE) - MM_FAMILY_CHUNK_BASE_SHIFT;
+}
+
+
+/**
+ * registered page family of a family_id below mm_registered_family_count()
+ */ 
+static inline vm_page_family_t* mm_registered_family(uint32_t family_id){
+
+    uint32_t chunk = mm_family_chunk(family_id);
+
+    return &family_chunks[chunk][family_id + MM_FAMILY_CHUNK_BASE - (MM_FAMILY_CHUNK_BASE << chunk)];
+}
+
+
+static inline uint32_t mm_registered_family_count(void){
+
+    return __atomic_load_n(&family_count, __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * print the VM pages of a registered page family, in concurrent mode the pages of every heap
+ */ 
+static uint32_t mm_print_family_memory_usage(vm_page_family_t* vm_page_family){
+
+#if MM_THREAD_SAFE
+    uint32_t system_page_count = 0;
+    uint32_t chunk = vm_page_family->family_id / MM_HEAP_FAMILIES_PER_CHUNK;
+    uint32_t slot = vm_page_family->family_id % MM_HEAP_FAMILIES_PER_CHUNK;
+    mm_heap_t* heap = NULL;
+
+    if(chunk >= MM_HEAP_MAX_FAMILY_CHUNKS){
+
+        return system_page_count;
+    }
+
+    pthread_mutex_lock(&mm_heap_list_lock);
+
+    for(heap = first_heap; heap; heap = heap->next){
+
+        vm_page_family_t** families = __atomic_load_n(&heap->families[chunk], __ATOMIC_ACQUIRE);
+
+        if(families && __atomic_load_n(&families[slot], __ATOMIC_ACQUIRE)){
+
+            system_page_count += mm_print_meta_block_usage(families[slot]);
+        }
+    }
+
+    pthread_mutex_unlock(&mm_heap_list_lock);
+
+    return system_page_count;
+#else
+    return mm_print_meta_block_usage(vm_page_family);
+#endif
+}
+
+
+/**
+ * find struct_name in the name index, the index must exist
+ */ 
+static inline vm_page_family_t* mm_family_name_index_lookup(const char* struct_name){
+
+    return family_name_index[mm_family_name_index_slot(family_name_index, family_name_index_size,
+            struct_name, mm_struct_name_hash(struct_name))];
+}
+
+
+/**
+ * add a new page family to the registry, the caller holds the registry lock
+ */ 
+static vm_page_family_t* mm_register_page_family(char* struct_name, uint32_t struct_size, uint32_t flags){
+
+    vm_page_family_t* current_family = NULL;
+
+    if(family_name_index && mm_family_name_index_lookup(struct_name)){
+
+        #if MM_DEBUG
+            printf("same structure %s!\n", struct_name);
+        #endif
+
+        assert(0);
+        return NULL;
+    }
+
+    if(((flags & MM_FAMILY_ALIGN_MASK) >> MM_FAMILY_ALIGN_SHIFT) > (uint32_t)__builtin_ctz(MM_MAX_ALIGNMENT)){
+
+        #if MM_DEBUG
+            printf("alignment of structure %s is above MM_MAX_ALIGNMENT!\n", struct_name);
+        #endif
+
+        return NULL;
+    }
+
+    uint32_t chunk = mm_family_chunk(family_count);
+
+    /* the first family of a chunk maps all of it, zero filled */
+    if(family_chunks[chunk] == NULL){
+
+        size_t length = (size_t)(MM_FAMILY_CHUNK_BASE << chunk) * sizeof(vm_page_family_t);
+
+        if((family_chunks[chunk] = mm_get_vm_page((uint32_t)((length + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE))) == NULL){
+
+            return NULL;
+        }
+    }
+
+    current_family = mm_registered_family(family_count);
+    /* a longer name is cut, it is terminated and looked up by the characters kept */
+    size_t name_length = strnlen(struct_name, MAX_NAME_LEN - 1);
+    memcpy(current_family->struct_name, struct_name, name_length);
+    current_family->struct_name[name_length] = '\0';
+    current_family->name_hash = mm_struct_name_hash(struct_name);
+    current_family->struct_size = struct_size;
+    current_family->flags = flags;
+    current_family->family_id = family_count;
+    current_family->heap = NULL;
+    current_family->reg_family = current_family;
+    current_family->first_page = NULL;
+    current_family->page_cache_high = MM_FAMILY_PAGE_CACHE_HIGH;
+    current_family->page_cache_low = MM_FAMILY_PAGE_CACHE_LOW;
+    memset(&current_family->counters, 0x0, sizeof(mm_family_counters_t));
+#if MM_LATENCY_HIST
+    memset(&current_family->latency, 0x0, sizeof(mm_latency_stats_t));
+#endif
+    mm_slab_init_geometry(current_family);
+    mm_init_free_block_list(current_family);
+
+    if(!mm_family_name_index_insert(current_family)){
+
+        memset(current_family, 0x0, sizeof(vm_page_family_t));
+        return NULL;
+    }
+
+    return current_family;
+}
+
+
+/**
+ * instantiate structure info and store it into VM Page,
+ * structures bigger than a VM Page are served by the large object path of zalloc,
+ * 'flags' are MM_FAMILY_* attributes, return the page family as a handle for zalloc_family()
+ */ 
+vm_page_family_t* mm_instantiate_new_page_family(char* struct_name, uint32_t struct_size, uint32_t flags){
+
+    vm_page_family_t* current_family = NULL;
+
+#if MM_THREAD_SAFE
+    pthread_rwlock_wrlock(&mm_registry_lock);
+    current_family = mm_register_page_family(struct_name, struct_size, flags);
+    pthread_rwlock_unlock(&mm_registry_lock);
+#else
+    current_family = mm_register_page_family(struct_name, struct_size, flags);
+#endif
+
+    return current_family;
+}
+
+
+/**
+ * iterate and print out structure messages
+ */ 
+void mm_print_registered_page_families(){
+
+    uint32_t count = mm_registered_family_count();
+
+    if(count == 0){
+
+        #if MM_DEBUG
+            printf("page families should be instantiated first!\n");
+        #endif
+        return;
+    }
+
+    for(uint32_t family_id=0; family_id<count; family_id++){
+
+        vm_page_family_t* current_family = mm_registered_family(family_id);
+
+        printf("Family %u: Struct Name: %s, Struct Size: %d\n", family_id, current_family->struct_name, current_family->struct_size);
+    }
+
+    printf("\r\n");
+}
+
+
+/**
+ * find particular struct_name among the registered page families through the hashed name index
+ */ 
+vm_page_family_t* lookup_page_family_by_name(char *struct_name){
+
+    vm_page_family_t* vm_page_family = NULL;
+
+#if MM_THREAD_SAFE
+    pthread_rwlock_rdlock(&mm_registry_lock);
+#endif
+
+    if(family_name_index){
+
+        vm_page_family = mm_family_name_index_lookup(struct_name);
+    }else{
+
+        #if MM_DEBUG
+            printf("page families should be instantiated first!\n");
+        #endif
+    }
+
+#if MM_THREAD_SAFE
+    pthread_rwlock_unlock(&mm_registry_lock);
+#endif
+
+    return vm_page_family;
+}
+
+
+/**
+ * check the vm_page is empty or not
+ */ 
+vm_bool_t mm_vm_page_is_empty(vm_page_t* vm_page){
+
+    assert(vm_page);
+
+    vm_bool_t ret = MM_META_BLK_IS_FREE(&vm_page->meta_blk) == MM_TRUE && 
+                    vm_page->meta_blk.next_offset == 0 && 
+                    vm_page->meta_blk.pre_offset == 0
+                    ? MM_TRUE : MM_FALSE;
+
+    return ret;
+}
+
+
+/**
+ * take an empty VM page from the page family's cache, then from the global cache
+ */ 
+static vm_page_t* mm_page_cache_get(vm_page_family_t* vm_page_family){
+
+    vm_page_t* vm_page = vm_page_family->cached_pages;
+
+    if(vm_page){
+
+        vm_page_family->cached_pages = vm_page->next_page;
+        --vm_page_family->cached_page_count;
+        return vm_page;
+    }
+
+    /* the global cache only holds normal pages */
+    if((vm_page_family->flags & MM_FAMILY_HUGEPAGE) ||
+        __atomic_load_n(&global_page_cache_count, __ATOMIC_RELAXED) == 0){
+
+        return NULL;
+    }
+
+    MM_LOCK(&mm_page_cache_lock);
+
+    vm_page = global_page_cache;
+
+    if(vm_page){
+
+        global_page_cache = vm_page->next_page;
+        __atomic_store_n(&global_page_cache_count, global_page_cache_count - 1, __ATOMIC_RELAXED);
+    }
+
+    MM_UNLOCK(&mm_page_cache_lock);
+
+    return vm_page;
+}
+
+
+/**
+ * retain an empty single system page VM page. Above its high-water mark the page family's cache
+ * spills into the global cache, above the global high-water mark the global cache goes back to the regions,
+ * each down to its low-water mark so that alloc/free around one page never reaches the kernel
+ */ 
+static void mm_page_cache_spill(vm_page_family_t* vm_page_family);
+
+static void mm_page_cache_put(vm_page_family_t* vm_page_family, vm_page_t* vm_page){
+
+    vm_page->next_page = vm_page_family->cached_pages;
+    vm_page_family->cached_pages = vm_page;
+
+    if(++vm_page_family->cached_page_count <= vm_page_family->reg_family->page_cache_high){
+
+        return;
+    }
+
+    mm_page_cache_spill(vm_page_family);
+}
+
+
+/**
+ * move the cached pages of a page family above its low-water mark to the global cache under one lock
+ */ 
+static void mm_page_cache_spill(vm_page_family_t* vm_page_family){
+
+    vm_page_family_t* reg_family = vm_page_family->reg_family;
+    vm_page_t* vm_page = NULL;
+    vm_page_t* unmap_list = NULL;
+
+    MM_LOCK(&mm_page_cache_lock);
+
+    while(vm_page_family->cached_page_count > reg_family->page_cache_low){
+
+        vm_page = vm_page_family->cached_pages;
+        vm_page_family->cached_pages = vm_page->next_page;
+        --vm_page_family->cached_page_count;
+
+        /* pages of huge regions go straight back to their region */
+        if(vm_page_family->flags & MM_FAMILY_HUGEPAGE){
+
+            vm_page->next_page = unmap_list;
+            unmap_list = vm_page;
+            continue;
+        }
+
+        vm_page->next_page = global_page_cache;
+        global_page_cache = vm_page;
+        __atomic_store_n(&global_page_cache_count, global_page_cache_count + 1, __ATOMIC_RELAXED);
+    }
+
+    if(global_page_cache_count > global_page_cache_high){
+
+        while(global_page_cache_count > global_page_cache_low){
+
+            vm_page = global_page_cache;
+            global_page_cache = vm_page->next_page;
+            __atomic_store_n(&global_page_cache_count, global_page_cache_count - 1, __ATOMIC_RELAXED);
+
+            vm_page->next_page = unmap_list;
+            unmap_list = vm_page;
+        }
+    }
+
+    MM_UNLOCK(&mm_page_cache_lock);
+
+    while(unmap_list){
+
+        vm_page = unmap_list;
+        unmap_list = vm_page->next_page;
+        mm_region_put_page(vm_page);
+    }
+}
+
+
+/**
+ * set the high/low water marks of the empty page cache of a registered page family
+ */ 
+void mm_set_family_page_cache(vm_page_family_t* vm_page_family, uint32_t high_water, uint32_t low_water){
+
+    if(vm_page_family == NULL){
+
+        return;
+    }
+
+    vm_page_family->reg_family->page_cache_high = high_water;
+    vm_page_family->reg_family->page_cache_low = low_water < high_water ? low_water : high_water;
+}
+
+
+#if MM_QUOTAS
+/**
+ * limit the system pages and the data bytes a registered page family holds over all threads, 0 for no
+ * limit. A family already above a new limit keeps its memory, its allocations fail until it is below
+ */ 
+vm_bool_t mm_set_family_quota(vm_page_family_t* page_family, uint64_t max_pages, uint64_t max_bytes){
+
+    if(page_family == NULL){
+
+        return MM_FALSE;
+    }
+
+    __atomic_store_n(&page_family->reg_family->quota.max_pages, max_pages, __ATOMIC_RELAXED);
+    __atomic_store_n(&page_family->reg_family->quota.max_bytes, max_bytes, __ATOMIC_RELAXED);
+
+    return MM_TRUE;
+}
+#endif
+
+
+/**
+ * set the high/low water marks of the global empty page cache
+ */ 
+void mm_set_global_page_cache(uint32_t high_water, uint32_t low_water){
+
+    MM_LOCK(&mm_page_cache_lock);
+    global_page_cache_high = high_water;
+    global_page_cache_low = low_water < high_water ? low_water : high_water;
+    MM_UNLOCK(&mm_page_cache_lock);
+}
+
+
+/**
+ * give every retained empty VM page of the global cache and of the caller's page families back to the regions
+ */ 
+void mm_flush_page_cache(void){
+
+    uint32_t count = mm_registered_family_count();
+    vm_page_t* vm_page = NULL;
+
+#if MM_THREAD_SAFE
+    /* pages emptied by other threads go into the caches first */
+    if(mm_thread_heap){
+
+        mm_heap_drain_remote_frees(mm_thread_heap);
+    }
+#endif
+
+    for(uint32_t family_id=0; family_id<count; family_id++){
+
+        vm_page_family_t* current_family = mm_registered_family(family_id);
+#if MM_THREAD_SAFE
+        vm_page_family_t** families = mm_thread_heap && current_family->family_id < MM_HEAP_FAMILIES_PER_CHUNK * MM_HEAP_MAX_FAMILY_CHUNKS ?
+                mm_thread_heap->families[current_family->family_id / MM_HEAP_FAMILIES_PER_CHUNK] : NULL;
+        vm_page_family_t* local_family = families ? families[current_family->family_id % MM_HEAP_FAMILIES_PER_CHUNK] : NULL;
+#else
+        vm_page_family_t* local_family = current_family;
+#endif
+        while(local_family && (vm_page = local_family->cached_pages)){
+
+            local_family->cached_pages = vm_page->next_page;
+            --local_family->cached_page_count;
+            mm_region_put_page(vm_page);
+        }
+    }
+
+    MM_LOCK(&mm_page_cache_lock);
+    vm_page_t* unmap_list = global_page_cache;
+    global_page_cache = NULL;
+    __atomic_store_n(&global_page_cache_count, 0, __ATOMIC_RELAXED);
+    MM_UNLOCK(&mm_page_cache_lock);
+
+    while(unmap_list){
+
+        vm_page = unmap_list;
+        unmap_list = vm_page->next_page;
+        mm_region_put_page(vm_page);
+    }
+}
+
+
+/**
+ * VM Page Insertion, single system page VM pages are reused from the empty page caches
+ * or carved out of a reserved region, large spans are mapped on their own
+ */ 
+vm_page_t* allocate_vm_page(vm_page_family_t* vm_page_family, uint32_t units){
+
+    if(vm_page_family == NULL){
+
+        #if MM_DEBUG
+            printf("Insert VM Page is NULL!\n");
+        #endif
+        return NULL;
+    }
+
+    vm_page_t* new_page = NULL;
+    uint32_t clean_offset = offset_of(vm_page_t, page_data_blk);
+    vm_bool_t clean = MM_TRUE;
+
+    if(!MM_QUOTA_CHARGE_PAGES(vm_page_family, units)){
+
+        #if MM_DEBUG
+            printf("page family %s is over its page quota!\n", vm_page_family->struct_name);
+        #endif
+        return NULL;
+    }
+
+    MM_HIST_START(start);
+
+    if(units == 1){
+
+        if((new_page = mm_page_cache_get(vm_page_family)) != NULL){
+
+            /* a retained page still knows how much of it was used */
+            clean_offset = new_page->clean_offset;
+        }else if((new_page = mm_region_get_page((vm_page_family->flags & MM_FAMILY_HUGEPAGE) ? MM_TRUE : MM_FALSE, &clean)) != NULL && !clean){
+
+            clean_offset = SYSTEM_PAGE_SIZE;
+        }
+    }else{
+
+        new_page = mm_get_vm_page(units);
+    }
+
+    if(new_page == NULL){
+
+        MM_QUOTA_UNCHARGE_PAGES(vm_page_family, units);
+        return NULL;
+    }
+
+    MM_HIST_RECORD(vm_page_family, MM_HIST_PAGE_ACQUIRE, start);
+
+    new_page->clean_offset = clean_offset;
+
+    /* set the back pointer to page family */
+    new_page->page_family = vm_page_family;
+    new_page->page_units = units;
+    new_page->page_type = MM_VM_PAGE_BLOCKS;
+    /* a reused page may have been a slab page: slab_free_count covers large_obj_offset, live_blocks and quick_blocks */
+    new_page->slab_free_count = 0;
+    MM_COUNTER_ADD(vm_page_family, pages, units);
+    mm_page_map_set(new_page, vm_page_family);
+
+    /* meta block init */
+    MARK_VM_PAGE_EMPTY(new_page);
+    MM_META_BLK_SET_SIZE(&new_page->meta_blk, mm_max_page_allocatable_memory(units));
+    new_page->pre_page = NULL;
+    new_page->next_page = NULL;
+
+    /* mantain vm_page_t dll */
+    if(vm_page_family->first_page == NULL){
+
+        vm_page_family->first_page = new_page;
+        return new_page;
+    }
+
+    new_page->next_page = vm_page_family->first_page;
+    vm_page_family->first_page->pre_page = new_page;
+    vm_page_family->first_page = new_page;
+
+    return new_page;
+}
+
+
+/**
+ * VM Page Deletion, an empty single system page VM page is retained in the empty page caches
+ */ 
+void mm_page_delete_and_free(vm_page_t* vm_page){
+
+    if(vm_page == NULL){
+
+        #if MM_DEBUG
+            printf("Delete VM Page is NULL!\n");
+        #endif
+        return;
+    }
+
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+
+    /* vm_page is the first page */
+    if(vm_page_family->first_page == vm_page){
+
+        vm_page_family->first_page = vm_page->next_page;
+        if(vm_page->next_page){
+
+            vm_page->next_page->pre_page = NULL;
+        }
+    }else{
+
+        /* vm_page is at the middle of the dll */
+        vm_page->pre_page->next_page = vm_page->next_page;
+        if(vm_page->next_page){
+
+            vm_page->next_page->pre_page = vm_page->pre_page;
+        }
+    }
+
+    vm_page->pre_page = NULL;
+    vm_page->next_page = NULL;
+    MM_COUNTER_SUB(vm_page_family, pages, vm_page->page_units);
+    MM_QUOTA_UNCHARGE_PAGES(vm_page_family, vm_page->page_units);
+    mm_page_map_clear(vm_page, vm_page_family);
+
+    MM_HIST_START(start);
+
+    if(MM_IS_LARGE_VM_PAGE(vm_page)){
+
+        mm_release_vm_page(vm_page, vm_page->page_units);
+    }else{
+
+        mm_page_cache_put(vm_page_family, vm_page);
+    }
+
+    MM_HIST_RECORD(vm_page_family, MM_HIST_PAGE_RELEASE, start);
+}
+
+
+/**
+ * test function 
+ */
+void mm_debug_fn(){
+    
+    mm_init();
+    printf("VM Page Size: %lu\n", SYSTEM_PAGE_SIZE);
+
+    void* addr1 = mm_get_vm_page(1);
+    void* addr2 = mm_get_vm_page(1);
+    printf("VM1: %p, VM2: %p\n", addr1, addr2);
+
+    mm_release_vm_page(addr1, 1);
+    mm_release_vm_page(addr2, 1);
+}
+
+
+/**
+ * zero the data about to be handed out, only the part below the clean offset of its
+ * VM page can hold old data
+ */ 
+static void mm_zero_data_block(vm_page_t* vm_page, uint8_t* data_blk, uint32_t size){
+
+    uint8_t* clean_data = (uint8_t*)vm_page + vm_page->clean_offset;
+
+    if(data_blk < clean_data){
+
+        memset(data_blk, 0x0, (data_blk + size < clean_data ? data_blk + size : clean_data) - data_blk);
+    }
+
+    MM_MARK_VM_PAGE_DIRTY(vm_page, data_blk + size);
+}
+
+
+/**
+ * allocate 'units' structures of a page family owned by the calling thread, aligned to the
+ * larger of 'alignment' and the family alignment
+ */ 
+static void* mm_allocate_local_units(vm_page_family_t* page_family, int units, vm_bool_t zero, uint32_t alignment){
+
+    uint64_t total_struct_size = (uint64_t)page_family->struct_size * units;
+    uint32_t size = 0;
+    meta_blk_t* free_blk = NULL;
+    vm_page_t* vm_page = NULL;
+    uint8_t* data_blk = NULL;
+
+    if(units == 1 && (page_family->flags & MM_FAMILY_SLAB) && alignment <= MM_FAMILY_ALIGNMENT(page_family)){
+
+        if(!MM_QUOTA_RESERVE_BYTES(page_family, page_family->struct_size)){
+
+            return NULL;
+        }
+
+        data_blk = mm_slab_allocate(page_family, &vm_page);
+        MM_QUOTA_RELEASE_BYTES(page_family);
+
+        if(data_blk == NULL){
+
+            return NULL;
+        }
+
+        if(zero){
+
+            mm_zero_data_block(vm_page, data_blk, page_family->struct_size);
+        }else{
+
+            MM_MARK_VM_PAGE_DIRTY(vm_page, data_blk + page_family->struct_size);
+        }
+
+        return data_blk;
+    }
+
+    if(alignment < MM_FAMILY_ALIGNMENT(page_family)){
+
+        alignment = MM_FAMILY_ALIGNMENT(page_family);
+    }
+
+    /* every data block is MM_DATA_BLK_ALIGN aligned already */
+    if(alignment <= MM_DATA_BLK_ALIGN){
+
+        alignment = 1;
+    }
+
+    if(total_struct_size > MM_META_BLK_MAX_SIZE - SYSTEM_PAGE_SIZE){
+
+        #if MM_DEBUG
+            printf("Memory requested is too large!\n");
+        #endif
+
+        return NULL;
+    }
+
+    size = mm_data_blk_size(total_struct_size);
+
+    if(alignment > 1){
+
+        /* the next block carved behind an aligned one is aligned as well */
+        size = MM_ALIGN_UP(size + META_SIZE, alignment) - META_SIZE;
+    }
+
+    if((uint64_t)size + (alignment > 1 ? alignment + META_SIZE + MM_MIN_DATA_BLK_SIZE : 0) > mm_max_page_allocatable_memory(1)){
+
+        /* the byte quota is checked against the block size that gets charged */
+        if(!MM_QUOTA_RESERVE_BYTES(page_family, total_struct_size + alignment - 1)){
+
+            return NULL;
+        }
+
+        free_blk = mm_allocate_large_data_block(page_family, (uint32_t)total_struct_size + alignment - 1);
+    }else if(!MM_QUOTA_RESERVE_BYTES(page_family, size)){
+
+        return NULL;
+    }else if(alignment > 1){
+
+        free_blk = mm_allocate_aligned_free_data_block(page_family, size, alignment);
+    }else{
+
+        free_blk = mm_allocate_free_data_block(page_family, size);
+    }
+
+    MM_QUOTA_RELEASE_BYTES(page_family);
+
+    if(free_blk == NULL){
+
+        return NULL;
+    }
+
+    vm_page = MM_GET_PAGE_FROM_META_BLOCK(free_blk);
+    data_blk = (uint8_t*)MM_ALIGN_UP((uintptr_t)(free_blk + 1), alignment);
+
+    if(MM_IS_LARGE_VM_PAGE(vm_page)){
+
+        vm_page->large_obj_offset = (uint32_t)(data_blk - (uint8_t*)vm_page);
+    }
+#if MM_QUICK_LIST_MAX_SIZE
+    else{
+
+        ++vm_page->live_blocks;
+    }
+#endif
+
+    /* a rounded up block is zeroed up to its size, zrealloc() grows into it */
+    size = MM_META_BLK_SIZE(free_blk) - (uint32_t)(data_blk - (uint8_t*)(free_blk + 1));
+    if(zero){
+
+        mm_zero_data_block(vm_page, data_blk, size);
+    }else{
+
+        /* only the rounding tail past the object */
+        mm_zero_data_block(vm_page, data_blk + total_struct_size, size - (uint32_t)total_struct_size);
+    }
+
+    return data_blk;
+}
+
+
+/**
+ * allocate 'units' structures of a page family, zeroed or not
+ */ 
+static void* mm_allocate_units(vm_page_family_t* page_family, int units, vm_bool_t zero, uint32_t alignment){
+
+    if(page_family == NULL || units <= 0){
+
+        return NULL;
+    }
+
+    MM_HIST_START(start);
+
+    if((page_family = mm_get_local_page_family(page_family)) == NULL){
+
+        return NULL;
+    }
+
+    void* data_blk = mm_allocate_local_units(page_family, units, zero, alignment);
+
+    MM_HIST_RECORD(page_family, MM_HIST_ZALLOC, start);
+    MM_TRACE_RECORD_ALLOC(data_blk, page_family, (uint32_t)units, alignment);
+
+    return data_blk;
+}
+
+
+/**
+ * dynamic memory allocation fnuc for applications, the family is given as a handle
+ */ 
+void* zalloc_family(vm_page_family_t* page_family, int units){
+
+    return mm_allocate_units(page_family, units, MM_TRUE, 1);
+}
+
+
+/**
+ * like zalloc_family() but the memory is not zeroed
+ */ 
+void* zalloc_family_nozero(vm_page_family_t* page_family, int units){
+
+    return mm_allocate_units(page_family, units, MM_FALSE, 1);
+}
+
+
+/**
+ * dynamic memory allocation fnuc for applications
+ */ 
+void* zalloc(char* struct_name, int units){
+
+    if(struct_name == NULL){
+
+        return NULL;
+    }
+
+    vm_page_family_t* page_family = NULL;
+
+    if((page_family = lookup_page_family_by_name(struct_name)) == NULL){
+
+        #if MM_DEBUG
+            printf("structure %s can't be found!\n", struct_name);
+        #endif
+
+        return NULL;
+    }
+
+    return zalloc_family(page_family, units);
+}
+
+
+/**
+ * like zalloc() but the memory is not zeroed
+ */ 
+void* zalloc_nozero(char* struct_name, int units){
+
+    if(struct_name == NULL){
+
+        return NULL;
+    }
+
+    return zalloc_family_nozero(lookup_page_family_by_name(struct_name), units);
+}
+
+
+/**
+ * like zalloc_family() but the object starts on an 'alignment' boundary, a power of 2 up to MM_MAX_ALIGNMENT
+ */ 
+void* zalloc_family_aligned(vm_page_family_t* page_family, int units, uint32_t alignment){
+
+    if(alignment == 0 || (alignment & (alignment - 1)) || alignment > MM_MAX_ALIGNMENT){
+
+        return NULL;
+    }
+
+    return mm_allocate_units(page_family, units, MM_TRUE, alignment);
+}
+
+
+/**
+ * like zalloc() but the object starts on an 'alignment' boundary
+ */ 
+void* zalloc_aligned(char* struct_name, int units, uint32_t alignment){
+
+    if(struct_name == NULL){
+
+        return NULL;
+    }
+
+    return zalloc_family_aligned(lookup_page_family_by_name(struct_name), units, alignment);
+}
+
+
+/**
+ * free an object, in concurrent mode an object owned by another thread's heap is handed to that heap.
+ * A pointer the memory manager did not hand out is ignored
+ */ 
+void zfree(void* addr){
+
+    MM_HIST_START(start);
+    MM_TRACE_RECORD_FREE(addr);
+
+    if(mm_owns(addr) == MM_FALSE){
 
         #if MM_DEBUG
-            printf("Split: full split\n");
+            printf("zfree: %p is not owned by the memory manager!\n", addr);
         #endif
+        return;
+    }
 
-        remaining_blk = NEXT_META_BLOCK_BY_SIZE(meta_blk);
-        remaining_blk->is_free = MM_TRUE;
-        remaining_blk->data_blk_size = remaining_size - META_SIZE;
-        remaining_blk->offset = meta_blk->offset + META_SIZE + meta_blk->data_blk_size;
-        glthread_init(&remaining_blk->priority_thread_glue);
-        mm_add_free_meta_block_to_free_block_list(page_family, remaining_blk);
-        MM_BIND_BLKS_FOR_ALLOCATION(meta_blk, remaining_blk);
+    vm_page_t* vm_page = MM_GET_PAGE_FROM_ADDR(addr);
+
+    /* an arena object goes away with its arena only */
+    if(vm_page->page_type == MM_VM_PAGE_ARENA){
+
+        return;
+    }
+
+#if MM_THREAD_SAFE
+    if(vm_page->page_family->heap != mm_thread_heap){
+
+        /* the family belongs to another thread, remote frees are not timed */
+        if(mm_is_remote_object(vm_page, addr)){
+
+            ((uintptr_t*)addr)[1] = MM_REMOTE_FREE_MARK(vm_page->page_family->heap);
+            mm_heap_push_remote_frees(vm_page->page_family->heap, addr, addr);
+        }
+        return;
+    }
+#endif
+
+#if MM_LATENCY_HIST
+    /* the VM page may be gone after the free */
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+#endif
+
+    mm_free_local(vm_page, addr);
+
+    MM_HIST_RECORD(vm_page_family, MM_HIST_ZFREE, start);
+}
+
+
+/**
+ * allocate n zeroed objects of 'units' structures each, the local family is looked up once and
+ * a free block is carved into as many objects as it holds, return the number of objects allocated
+ */ 
+static int mm_allocate_batch(vm_page_family_t* page_family, int units, int n, void** out_ptrs){
+
+    if(page_family == NULL || units <= 0 || n <= 0 || out_ptrs == NULL){
+
+        return 0;
+    }
+
+    if((page_family = mm_get_local_page_family(page_family)) == NULL){
+
+        return 0;
+    }
+
+    uint64_t total_struct_size = (uint64_t)page_family->struct_size * units;
+    uint32_t size = 0;
+    meta_blk_t* free_blk = NULL;
+    vm_page_t* vm_page = NULL;
+    int count = 0, carved = 0;
+
+    /* slab slots, aligned and large objects have no split to share */
+    if((units == 1 && (page_family->flags & MM_FAMILY_SLAB)) || MM_FAMILY_ALIGNMENT(page_family) > 1 ||
+       total_struct_size > mm_max_page_allocatable_memory(1)){
+
+        for(; count < n; count++){
+
+            if((out_ptrs[count] = mm_allocate_local_units(page_family, units, MM_TRUE, 1)) == NULL){
+
+                break;
+            }
+        }
+
+        return count;
+    }
+
+    size = mm_data_blk_size(total_struct_size);
+
+    /* the byte quota is checked for the whole batch, objects that take another path are checked one by one */
+    if(!MM_QUOTA_RESERVE_BYTES(page_family, (uint64_t)size * n)){
+
+        return 0;
+    }
+
+    while(count < n){
+
+        if((free_blk = mm_get_free_block_page_family(page_family, size)) == NULL){
+
+            if((vm_page = mm_family_add_new_page(page_family)) == NULL){
+
+                break;
+            }
+
+            free_blk = &vm_page->meta_blk;
+        }
+
+        vm_page = MM_GET_PAGE_FROM_META_BLOCK(free_blk);
+        carved = (int)mm_split_free_data_block_for_batch(page_family, free_blk, size, (uint32_t)(n - count), out_ptrs + count);
+
+        /* like mm_allocate_local_units(), a rounded up block is zeroed up to its size for zrealloc() */
+        for(; carved; carved--, count++){
+
+            mm_zero_data_block(vm_page, out_ptrs[count], MM_META_BLK_SIZE((meta_blk_t*)GET_META_BLK(out_ptrs[count])));
+#if MM_QUICK_LIST_MAX_SIZE
+            ++vm_page->live_blocks;
+#endif
+        }
+    }
+
+    MM_QUOTA_RELEASE_BYTES(page_family);
+
+    return count;
+}
+
+
+/**
+ * allocate n zeroed objects of 'units' structures each, return the number of objects allocated
+ */ 
+int zalloc_batch(vm_page_family_t* page_family, int units, int n, void** out_ptrs){
+
+    int count = mm_allocate_batch(page_family, units, n, out_ptrs);
+
+#if MM_TRACE
+    for(int i=0; i<count; i++){
+
+        MM_TRACE_RECORD_ALLOC(out_ptrs[i], page_family, (uint32_t)units, 1);
+    }
+#endif
+
+    return count;
+}
+
+
+/**
+ * free n objects, consecutive objects of the same VM page are coalesced with one walk of the page
+ */ 
+void zfree_batch(void** ptrs, int n){
+
+    int i = 0, j = 0;
+    vm_page_t* vm_page = NULL;
+    meta_blk_t* free_blk = NULL;
+#if MM_THREAD_SAFE
+    mm_heap_t* heap = NULL;
+#endif
+#if MM_QUICK_LIST_MAX_SIZE
+    vm_bool_t drain = MM_FALSE;
+#endif
+
+#if MM_TRACE
+    for(i=0; i<n; i++){
+
+        MM_TRACE_RECORD_FREE(ptrs[i]);
+    }
+    i = 0;
+#endif
+
+    while(i < n){
+
+        vm_page = MM_GET_PAGE_FROM_ADDR(ptrs[i]);
+
+        if(mm_owns(ptrs[i]) == MM_FALSE || vm_page->page_type == MM_VM_PAGE_ARENA){
+
+            i++;
+            continue;
+        }
+
+#if MM_THREAD_SAFE
+        if((heap = vm_page->page_family->heap) != mm_thread_heap){
+
+            if(mm_is_remote_object(vm_page, ptrs[i]) == MM_FALSE){
+
+                i++;
+                continue;
+            }
+
+            /* a run of objects of the same other heap goes over with one push */
+            ((uintptr_t*)ptrs[i])[1] = MM_REMOTE_FREE_MARK(heap);
+            for(j = i + 1; j < n && mm_owns(ptrs[j]) && MM_GET_PAGE_FROM_ADDR(ptrs[j])->page_type != MM_VM_PAGE_ARENA &&
+                MM_GET_PAGE_FROM_ADDR(ptrs[j])->page_family->heap == heap &&
+                mm_is_remote_object(MM_GET_PAGE_FROM_ADDR(ptrs[j]), ptrs[j]); j++){
+
+                ((uintptr_t*)ptrs[j])[1] = MM_REMOTE_FREE_MARK(heap);
+                *(void**)ptrs[j - 1] = ptrs[j];
+            }
+
+            mm_heap_push_remote_frees(heap, ptrs[i], ptrs[j - 1]);
+            i = j;
+            continue;
+        }
+#endif
+
+        if(vm_page->page_type == MM_VM_PAGE_SLAB || MM_IS_LARGE_VM_PAGE(vm_page) ||
+           i + 1 == n || MM_GET_PAGE_FROM_ADDR(ptrs[i + 1]) != vm_page){
+
+            mm_free_local(vm_page, ptrs[i++]);
+            continue;
+        }
+
+        for(j = i; j < n && MM_GET_PAGE_FROM_ADDR(ptrs[j]) == vm_page; j++){
+
+            if(mm_is_allocated_object(vm_page, ptrs[j]) == MM_FALSE){
+
+                #if MM_DEBUG
+                    printf("zfree_batch: %p is not an allocated object, double free?\n", ptrs[j]);
+                #endif
+                continue;
+            }
+
+            free_blk = GET_META_BLK(ptrs[j]);
+
+            mm_count_freed_block(vm_page->page_family, MM_META_BLK_SIZE(free_blk), mm_block_hard_IF(free_blk));
+            MM_META_BLK_SET_FREE(free_blk, MM_TRUE);
+            glthread_init(MM_META_BLK_GLUE(free_blk));
+#if MM_QUICK_LIST_MAX_SIZE
+            --vm_page->live_blocks;
+#endif
+        }
+
+#if MM_QUICK_LIST_MAX_SIZE
+        /* the page is not released while quick blocks are left in it, they are coalesced after the walk */
+        drain = vm_page->live_blocks == 0 && vm_page->quick_blocks ? MM_TRUE : MM_FALSE;
+        mm_free_vm_page_blocks(vm_page);
+        if(drain){
+
+            mm_quick_lists_drain(vm_page->page_family);
+        }
+#else
+        mm_free_vm_page_blocks(vm_page);
+#endif
+        i = j;
+    }
+}
+
+
+/**
+ * resize a large object with mremap(), the kernel moves the pages instead of copying the data
+ */ 
+static void* mm_realloc_large_data_block(vm_page_t* vm_page, uint32_t size){
+
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+    uint32_t old_units = vm_page->page_units;
+    uint32_t units = mm_large_object_page_units(size);
+    uint32_t old_size = MM_META_BLK_SIZE(&vm_page->meta_blk);
+    vm_page_t* new_page = vm_page;
+
+    if(size > old_size && !MM_QUOTA_RESERVE_BYTES(vm_page_family, size - old_size)){
+
+        return NULL;
+    }
+
+    if(units != old_units){
+
+        if(units > old_units && !MM_QUOTA_CHARGE_PAGES(vm_page_family, units - old_units)){
+
+            return NULL;
+        }
+
+        new_page = mremap(vm_page, old_units * SYSTEM_PAGE_SIZE, units * SYSTEM_PAGE_SIZE, MREMAP_MAYMOVE);
+
+        if(new_page == MAP_FAILED){
+
+            #if MM_DEBUG
+                printf("Error: could not mremap a large object\n");
+            #endif
+            if(units > old_units){
+
+                MM_QUOTA_UNCHARGE_PAGES(vm_page_family, units - old_units);
+            }
+            return NULL;
+        }
+
+        if(units < old_units){
+
+            MM_QUOTA_UNCHARGE_PAGES(vm_page_family, old_units - units);
+        }
+
+        /* the page may have moved, relink it */
+        if(new_page != vm_page){
+
+            mm_page_map_clear(vm_page, vm_page_family);
+            mm_page_map_set(new_page, vm_page_family);
+        }
+
+        if(new_page->pre_page){
+
+            new_page->pre_page->next_page = new_page;
+        }else{
+
+            vm_page_family->first_page = new_page;
+        }
+
+        if(new_page->next_page){
+
+            new_page->next_page->pre_page = new_page;
+        }
+
+        if(new_page->clean_offset > units * SYSTEM_PAGE_SIZE){
+
+            new_page->clean_offset = units * SYSTEM_PAGE_SIZE;
+        }
+
+        new_page->page_units = units;
+        MM_COUNTER_ADD(vm_page_family, pages, (int64_t)units - old_units);
+    }
+
+    mm_count_freed_block(vm_page_family, old_size, mm_max_page_allocatable_memory(old_units) - old_size);
+    mm_count_allocated_block(vm_page_family, size, mm_max_page_allocatable_memory(units) - size);
+    MM_META_BLK_SET_SIZE(&new_page->meta_blk, size);
+
+    if(size > old_size){
+
+        mm_zero_data_block(new_page, new_page->page_data_blk + old_size, size - old_size);
+    }
+
+    return new_page->page_data_blk;
+}
+
+
+/**
+ * resize a block in place to 'size' bytes of which 'used' are the object: grow into the hard internal
+ * fragmentation and the next block if it is free, shrink by giving the tail back as a free block,
+ * return MM_FALSE if the block can't grow
+ */ 
+static vm_bool_t mm_realloc_data_block_in_place(vm_page_t* vm_page, meta_blk_t* meta_blk, uint32_t size, uint32_t used){
+
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+    meta_blk_t* next_meta_blk = NEXT_META_BLOCK(meta_blk);
+    uint32_t old_size = MM_META_BLK_SIZE(meta_blk);
+    uint8_t* tail_of_data_blk = (uint8_t*)(meta_blk + 1) + old_size;
+    uint32_t hard_IF = (uint32_t)((next_meta_blk ? (uint8_t*)next_meta_blk : (uint8_t*)vm_page + SYSTEM_PAGE_SIZE) - tail_of_data_blk);
+    uint32_t capacity = old_size + hard_IF;
+    meta_blk_t* tail_blk = NULL;
+
+    if(size <= old_size){
+
+        /* the bytes past the object that stay with the block are kept zero for a later growth */
+        if(old_size - size < META_SIZE + MM_MIN_DATA_BLK_SIZE){
+
+            memset((uint8_t*)(meta_blk + 1) + used, 0x0, old_size - used);
+            return MM_TRUE;
+        }
+
+        memset((uint8_t*)(meta_blk + 1) + used, 0x0, size - used);
+
+        /* free the tail as if it had been a block of its own */
+        tail_blk = (meta_blk_t*)((uint8_t*)(meta_blk + 1) + size);
+        tail_blk->size_and_free = old_size - size - META_SIZE;
+        meta_blk->size_and_free = size;
+        MM_BIND_BLKS_FOR_ALLOCATION(meta_blk, tail_blk);
+
+        mm_count_freed_block(vm_page_family, old_size, hard_IF);
+        mm_count_allocated_block(vm_page_family, size, 0);
+        mm_count_allocated_block(vm_page_family, MM_META_BLK_SIZE(tail_blk), hard_IF);
+        mm_free_blocks(tail_blk);
+
+        return MM_TRUE;
+    }
+
+    if(next_meta_blk && MM_META_BLK_IS_FREE(next_meta_blk) == MM_TRUE){
+
+        capacity += META_SIZE + MM_META_BLK_SIZE(next_meta_blk);
+    }
+
+    if(capacity < size){
+
+        return MM_FALSE;
+    }
+
+    /* merge the free neighbour, then split what is not needed off again */
+    mm_count_freed_block(vm_page_family, old_size, hard_IF);
+    if(next_meta_blk && MM_META_BLK_IS_FREE(next_meta_blk) == MM_TRUE){
+
+        mm_remove_free_meta_block_from_free_block_list(vm_page_family, next_meta_blk);
+        MM_BIND_BLKS_FOR_DEALLOCATION(meta_blk, next_meta_blk);
+    }
+
+    meta_blk->size_and_free = capacity;
+    mm_split_data_block(vm_page_family, meta_blk, size);
+    mm_zero_data_block(vm_page, tail_of_data_blk, size - old_size);
+
+    return MM_TRUE;
+}
+
+
+/**
+ * resize an object to new_units structures of its page family, in place if possible, the bytes past
+ * the old object are zeroed, return the object's new address or NULL with the object unchanged
+ */ 
+static void* mm_realloc_units(void* addr, int new_units){
+
+    if(addr == NULL || new_units <= 0){
+
+        if(addr){
+
+            zfree(addr);
+        }
+        return NULL;
+    }
+
+    if(mm_owns(addr) == MM_FALSE){
+
+        return NULL;
+    }
+
+    vm_page_t* vm_page = MM_GET_PAGE_FROM_ADDR(addr);
+    vm_page_family_t* vm_page_family = vm_page->page_family;
+    uint64_t total_struct_size = (uint64_t)vm_page_family->struct_size * new_units;
+    uint32_t size = mm_data_blk_size(total_struct_size);
+    uint32_t old_size = vm_page_family->struct_size;
+    uint32_t alignment = MM_FAMILY_ALIGNMENT(vm_page_family) <= MM_DATA_BLK_ALIGN ? 1 : MM_FAMILY_ALIGNMENT(vm_page_family);
+    meta_blk_t* meta_blk = NULL;
+    void* new_addr = NULL;
+
+    /* an arena object has no page family to move to */
+    if(vm_page->page_type == MM_VM_PAGE_ARENA){
+
+        return NULL;
+    }
+
+#if MM_THREAD_SAFE
+    if(vm_page_family->heap != mm_thread_heap ? !mm_is_remote_object(vm_page, addr) : !mm_is_allocated_object(vm_page, addr)){
+#else
+    if(mm_is_allocated_object(vm_page, addr) == MM_FALSE){
+#endif
+
+        return NULL;
+    }
+
+    if(total_struct_size > MM_META_BLK_MAX_SIZE - SYSTEM_PAGE_SIZE){
+
+        return NULL;
+    }
+
+    if(alignment > 1){
+
+        size = MM_ALIGN_UP(size + META_SIZE, alignment) - META_SIZE;
     }
 
-    return MM_TRUE;
-}
+#if MM_THREAD_SAFE
+    /* only the owner can resize in place */
+    if(vm_page_family->heap == mm_thread_heap){
+#endif
+        if(vm_page->page_type == MM_VM_PAGE_SLAB){
 
+            if(new_units == 1){
 
-/**
- * return meta block of free data block 
- */ 
-static meta_blk_t* mm_allocate_free_data_block(vm_page_family_t* page_family, uint32_t size){
+                return addr;
+            }
+        }else if(MM_IS_LARGE_VM_PAGE(vm_page)){
 
-    vm_bool_t status = MM_FALSE;
-    vm_page_t* vm_page = NULL;
-    meta_blk_t* bf_meta_blk = mm_get_biggest_free_block_page_family(page_family);
+            /* an aligned large object moves, mremap() keeps the offset of the data from the page only */
+            if(total_struct_size > mm_max_page_allocatable_memory(1) && addr == vm_page->page_data_blk){
 
-    if(!bf_meta_blk || bf_meta_blk->data_blk_size < size){
+                new_addr = mm_realloc_large_data_block(vm_page, (uint32_t)total_struct_size);
+                MM_QUOTA_RELEASE_BYTES(vm_page_family);
+                return new_addr;
+            }
+        }else if((uint64_t)size + (alignment > 1 ? alignment + META_SIZE + MM_MIN_DATA_BLK_SIZE : 0) <= mm_max_page_allocatable_memory(1)){
 
-        #if MM_DEBUG
-            printf("request new VM Page!\n");
-        #endif
+            meta_blk = GET_META_BLK(addr);
+            if(size > MM_META_BLK_SIZE(meta_blk) && !MM_QUOTA_RESERVE_BYTES(vm_page_family, size - MM_META_BLK_SIZE(meta_blk))){
 
-        vm_page = mm_family_add_new_page(page_family); // bug
-        status = mm_split_free_data_block_for_allocation(page_family, &vm_page->meta_blk, size); // bug
+                return NULL;
+            }
 
-        if(status){
+            new_addr = mm_realloc_data_block_in_place(vm_page, meta_blk, size, (uint32_t)total_struct_size) ? addr : NULL;
+            MM_QUOTA_RELEASE_BYTES(vm_page_family);
 
-            return &vm_page->meta_blk;
+            if(new_addr){
+
+                return addr;
+            }
         }
+#if MM_THREAD_SAFE
+    }
+#endif
 
-        return NULL;
+    /* move: the old size in whole structures is what the object can hold */
+    if(MM_IS_LARGE_VM_PAGE(vm_page)){
+
+        old_size = MM_META_BLK_SIZE(&vm_page->meta_blk) - (uint32_t)((uint8_t*)addr - vm_page->page_data_blk);
+        old_size = old_size / vm_page_family->struct_size * vm_page_family->struct_size;
+    }else if(vm_page->page_type != MM_VM_PAGE_SLAB){
+
+        meta_blk = GET_META_BLK(addr);
+        old_size = MM_META_BLK_SIZE(meta_blk) / vm_page_family->struct_size * vm_page_family->struct_size;
     }
 
-    if(bf_meta_blk){
+    if((new_addr = zalloc_family(vm_page_family->reg_family, new_units)) == NULL){
 
-        status = mm_split_free_data_block_for_allocation(page_family, bf_meta_blk, size);
+        return NULL;
     }
 
-    if(status){
+    memcpy(new_addr, addr, old_size < total_struct_size ? old_size : total_struct_size);
+    zfree(addr);
 
-        return bf_meta_blk;
+    return new_addr;
+}
+
+
+/**
+ * resize an object to new_units structures of its page family, see mm_realloc_units()
+ */ 
+void* zrealloc(void* addr, int new_units){
+
+#if MM_TRACE
+    mm_trace_slot_t entry;
+    vm_bool_t traced = mm_trace_realloc_begin(addr, &entry);
+
+    /* a move is one realloc record, not an alloc and a free */
+    mm_trace_muted++;
+    void* new_addr = mm_realloc_units(addr, new_units);
+    mm_trace_muted--;
+
+    if(traced){
+
+        mm_trace_realloc_end(addr, new_addr, new_units, &entry);
     }
 
-    return NULL;
+    return new_addr;
+#else
+    return mm_realloc_units(addr, new_units);
+#endif
 }
 
 
 /**
- * hand hard internal fragmentation when carry out merging
+ * set up an empty arena, its VM pages come from the empty page caches and the regions
  */ 
-static uint32_t mm_get_hard_internal_memory_frag_size(meta_blk_t* first, meta_blk_t* second){
+void mm_arena_init(mm_arena_t* arena){
 
-    meta_blk_t* idea_meta_blk = NEXT_META_BLOCK_BY_SIZE(first);
+    assert(arena);
 
-    return (uint32_t)((uint64_t)second - (uint64_t)idea_meta_blk);
+    memset(arena, 0x0, sizeof(mm_arena_t));
+    strncpy(arena->page_owner.struct_name, "arena", MAX_NAME_LEN - 1);
+    arena->page_owner.struct_size = 1;
+    arena->page_owner.reg_family = &arena->page_owner;
+    /* no per arena page cache, released pages go straight to the global cache */
+    arena->page_owner.page_cache_high = 0;
+    arena->page_owner.page_cache_low = 0;
 }
 
 
 /**
- * 
+ * bump allocate 'units' zeroed structures of a page family in the arena, aligned to the family
+ * alignment. An object too large for a single system page VM page gets a VM page of its own
  */ 
-static meta_blk_t* mm_free_blocks(meta_blk_t* free_meta_blk){
+void* zalloc_arena(mm_arena_t* arena, vm_page_family_t* page_family, int units){
 
-    free_meta_blk->is_free = MM_TRUE;
-    meta_blk_t* next_meta_blk = NEXT_META_BLOCK(free_meta_blk);
-    meta_blk_t* pre_meta_blk = PREV_META_BLOCK(free_meta_blk);
-    meta_blk_t* ret = NULL;
-    vm_page_t* vm_page = MM_GET_PAGE_FROM_META_BLOCK(free_meta_blk);
-    vm_page_family_t* vm_page_family = vm_page->page_family;
+    if(arena == NULL || page_family == NULL || units <= 0){
 
-    if(next_meta_blk){
+        return NULL;
+    }
 
-        free_meta_blk->data_blk_size += mm_get_hard_internal_memory_frag_size(free_meta_blk, next_meta_blk);
-    }else{
+    uint64_t size = (uint64_t)page_family->struct_size * units;
+    uint32_t alignment = MM_FAMILY_ALIGNMENT(page_family) < MM_DATA_BLK_ALIGN ? MM_DATA_BLK_ALIGN : MM_FAMILY_ALIGNMENT(page_family);
+    vm_page_t* vm_page = NULL;
+    uint8_t* data_blk = NULL;
 
-        uint8_t* top_of_vm_page = (uint8_t*)vm_page + SYSTEM_PAGE_SIZE;
-        uint8_t* tail_of_data_blk = (uint8_t*)(free_meta_blk + 1) + free_meta_blk->data_blk_size;
-        uint64_t hard_IF = (uint64_t)(top_of_vm_page - tail_of_data_blk);
-        free_meta_blk->data_blk_size += hard_IF;
+    if(size > MM_META_BLK_MAX_SIZE - SYSTEM_PAGE_SIZE){
+
+        return NULL;
     }
 
-    if(next_meta_blk && next_meta_blk->is_free == MM_TRUE){
- 
-        mm_union_free_blocks(free_meta_blk, next_meta_blk);
-        ret = free_meta_blk;
+    data_blk = (uint8_t*)MM_ALIGN_UP((uintptr_t)arena->bump_cursor, alignment);
+
+    if(arena->bump_page && data_blk + size <= arena->bump_limit){
+
+        arena->bump_cursor = data_blk + size;
+        mm_zero_data_block(arena->bump_page, data_blk, (uint32_t)size);
+        return data_blk;
     }
 
-    if(pre_meta_blk && pre_meta_blk->is_free == MM_TRUE){
+    if(size + alignment > mm_max_page_allocatable_memory(1)){
 
-        mm_union_free_blocks(pre_meta_blk, free_meta_blk);
-        ret = pre_meta_blk;
+        /* the current bump page keeps its room for the objects after this one */
+        if((vm_page = allocate_vm_page(&arena->page_owner, mm_large_object_page_units((uint32_t)size + alignment))) == NULL){
+
+            return NULL;
+        }
+
+        vm_page->page_type = MM_VM_PAGE_ARENA;
+        data_blk = (uint8_t*)MM_ALIGN_UP((uintptr_t)vm_page->page_data_blk, alignment);
+        mm_zero_data_block(vm_page, data_blk, (uint32_t)size);
+        return data_blk;
     }
 
-    if(mm_vm_page_is_empty(vm_page)){
+    if((vm_page = allocate_vm_page(&arena->page_owner, 1)) == NULL){
 
-        mm_page_delete_and_free(vm_page);
         return NULL;
     }
 
-    mm_add_free_meta_block_to_free_block_list(vm_page_family, ret);
+    vm_page->page_type = MM_VM_PAGE_ARENA;
+    arena->bump_page = vm_page;
+    arena->bump_limit = (uint8_t*)vm_page + SYSTEM_PAGE_SIZE;
 
-    return ret;
+    data_blk = (uint8_t*)MM_ALIGN_UP((uintptr_t)vm_page->page_data_blk, alignment);
+    arena->bump_cursor = data_blk + size;
+    mm_zero_data_block(vm_page, data_blk, (uint32_t)size);
+
+    return data_blk;
 }
 
 
 /**
- * print all meta blocks in the vm page
+ * release the VM pages of an arena but 'keep_page', the single system page VM pages are handed
+ * to the global cache under one lock, large VM pages are unmapped
  */ 
-static uint32_t mm_print_meta_block_usage(vm_page_family_t* current_family){
-
-    uint32_t page_count = 0;
-
-    if(current_family == NULL){
+static void mm_arena_release_pages(mm_arena_t* arena, vm_page_t* keep_page){
 
-        return page_count;
-    }
+    vm_page_family_t* page_owner = &arena->page_owner;
+    vm_page_t* vm_page = page_owner->first_page;
+    vm_page_t* next_page = NULL;
 
-    vm_page_t* vm_page = current_family->first_page;
+    page_owner->first_page = NULL;
 
-    if(vm_page == NULL){
+    for(; vm_page; vm_page = next_page){
 
-        return page_count;
-    }
+        next_page = vm_page->next_page;
+        vm_page->pre_page = NULL;
+        vm_page->next_page = NULL;
 
-    printf("Struct Name: %s, Struct Size: %d\n", current_family->struct_name, current_family->struct_size);
+        if(vm_page == keep_page){
 
-    meta_blk_t* meta_blk = NULL;
-    vm_page_t* vm_page_ptr = vm_page;
-    uint32_t meta_data_size = current_family->struct_size + META_SIZE;
+            page_owner->first_page = vm_page;
+            continue;
+        }
 
-    while(vm_page_ptr){
+        MM_COUNTER_SUB(page_owner, pages, vm_page->page_units);
+        MM_QUOTA_UNCHARGE_PAGES(page_owner, vm_page->page_units);
+        mm_page_map_clear(vm_page, page_owner);
 
-        uint32_t block_counter = 1;
-        uint32_t OBC = 0, FBC = 0;
+        if(MM_IS_LARGE_VM_PAGE(vm_page)){
 
-        printf(ANSI_COLOR_MAGENTA "\nVM Page: %u\n" ANSI_COLOR_RESET, ++page_count);
-        printf("\tpre page = %p, next page = %p\n", vm_page_ptr->pre_page, vm_page_ptr->next_page);
-        ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page_ptr, meta_blk)
-            printf(ANSI_COLOR_RED "\tBlock %d: %p" ANSI_COLOR_RESET, block_counter++, meta_blk);
-            printf(ANSI_COLOR_YELLOW "%s" ANSI_COLOR_RESET, meta_blk->is_free ? " F R E E D " : " ALLOCATED ");
-            printf(ANSI_COLOR_BLUE "data_blk_size = %-6u offset = %-6u pre meta = %-14p next meta = %p\n" ANSI_COLOR_RESET,
-                    meta_blk->data_blk_size, meta_blk->offset, meta_blk->pre_blk, meta_blk->next_blk);
+            mm_release_vm_page(vm_page, vm_page->page_units);
+            continue;
+        }
 
-            OBC = meta_blk->is_free ? OBC : OBC+1;
-            FBC = meta_blk->is_free ? FBC+1 : FBC;
-        ITERATE_VM_PAGE_ALL_BLOCKS_END
+        vm_page->next_page = page_owner->cached_pages;
+        page_owner->cached_pages = vm_page;
+        ++page_owner->cached_page_count;
+    }
 
-        printf("\t%-15sTotal blocks: %-6u Allocated blocks: %-6u Free blocks: %-6u Memory in use: %-6u\n\n",
-                 current_family->struct_name, OBC + FBC, OBC, FBC, OBC * meta_data_size);
+    if(page_owner->cached_page_count){
 
-        vm_page_ptr = vm_page_ptr->next_page;
+        mm_page_cache_spill(page_owner);
     }
-
-    return page_count;
 }
 
 
 /**
- * instantiate structure info and store it into VM Page 
+ * free every object of the arena at once, the current bump page is kept for the next objects
+ * and all the other VM pages go back to the page cache
  */ 
-void mm_instantiate_new_page_family(char* struct_name, uint32_t struct_size){
+void mm_arena_reset(mm_arena_t* arena){
 
-    if(struct_size > SYSTEM_PAGE_SIZE){
+    if(arena == NULL){
 
-        #if MM_DEBUG
-            printf("%s() can not instantiate size that exceeds %ld bytes!\n", __FUNCTION__, SYSTEM_PAGE_SIZE);
-        #endif
         return;
     }
 
-    vm_page_family_t* current_family = NULL;
-    vm_page_family_list_t* new_vm_page_for_family = NULL;
+    mm_arena_release_pages(arena, arena->bump_page);
+
+    if(arena->bump_page){
+
+        arena->bump_cursor = arena->bump_page->page_data_blk;
+    }
+}
 
-    if(first_vm_page_for_family == NULL){
 
-        first_vm_page_for_family = (vm_page_family_list_t*)mm_get_vm_page(1);
-        first_vm_page_for_family->next = NULL;
+/**
+ * free every object of the arena and return all of its VM pages to the page cache,
+ * the arena can be used again after mm_arena_init()
+ */ 
+void mm_arena_destroy(mm_arena_t* arena){
 
-        strncpy(first_vm_page_for_family->vm_page[0].struct_name, struct_name, MAX_NAME_LEN);
-        first_vm_page_for_family->vm_page[0].struct_size = struct_size;
-        first_vm_page_for_family->vm_page[0].first_page = NULL;
-        glthread_init(&first_vm_page_for_family->vm_page[0].free_blks_pq);
+    if(arena == NULL){
 
         return;
     }
 
-    uint32_t count = 0;
+    mm_arena_release_pages(arena, NULL);
+    arena->bump_page = NULL;
+    arena->bump_cursor = NULL;
+    arena->bump_limit = NULL;
+}
 
-    ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_family, current_family)
 
-        if(strncmp(current_family->struct_name, struct_name, MAX_NAME_LEN) == 0){
+/**
+ * 
+ */ 
+void mm_print_memory_usage(){
 
-            #if MM_DEBUG
-                printf("same structure %s!\n", struct_name);
-            #endif
+    uint32_t count = mm_registered_family_count();
+    uint32_t total_page = 0;
 
-            assert(0);
-        }
-        ++count;
-    ITERATE_PAGE_FAMILIES_END
+    if(count == 0){
+        
+        #if MM_DEBUG
+            printf("page families should be instantiated first!\n");
+        #endif
+        return;
+    }
 
-    if(count == MAX_FAMILY_PER_PAGE){
+    printf(ANSI_COLOR_GREEN "Registered page families = %u\n" ANSI_COLOR_RESET, count);
+    for(uint32_t family_id=0; family_id<count; family_id++){
 
-        new_vm_page_for_family = (vm_page_family_list_t*)mm_get_vm_page(1);
-        new_vm_page_for_family->next = first_vm_page_for_family;
-        first_vm_page_for_family = new_vm_page_for_family;
-        count = 0;    
+        total_page += mm_print_family_memory_usage(mm_registered_family(family_id));
     }
 
-    strncpy(first_vm_page_for_family->vm_page[count].struct_name, struct_name, MAX_NAME_LEN);
-    first_vm_page_for_family->vm_page[count].struct_size = struct_size;
-    first_vm_page_for_family->vm_page[count].first_page = NULL;
-    glthread_init(&first_vm_page_for_family->vm_page[count].free_blks_pq);
+    printf("Total Memory being used by Memory Manager = %lu\n", total_page*SYSTEM_PAGE_SIZE);
+    printf("Empty VM pages retained in the global cache = %u\n", global_page_cache_count);
+    printf("VM regions reserved = %u (%lu bytes each)\n", region_count, (unsigned long)MM_REGION_SIZE);
+    printf("Free region pages released to the kernel = %u\n", released_page_count);
 }
 
 
 /**
- * iterate and print out structure messages
+ * give memory the memory manager does not use back to the kernel: the empty VM pages retained by
+ * the caller's page families and the global cache go back to their regions, then the used free pages
+ * of every region are released. Return the number of system pages released
  */ 
-void mm_print_registered_page_families(){
+uint32_t mm_trim(void){
 
-    if(first_vm_page_for_family == NULL){
-
-        #if MM_DEBUG
-            printf("first_vm_page_for_family should be instantiated first!\n");
-        #endif
-        return;
-    }
+    mm_region_t* region = NULL;
+    uint32_t released = 0;
 
-    vm_page_family_list_t* list_ptr = first_vm_page_for_family;
-    vm_page_family_t* current_family = NULL;
-    uint32_t vm_number = 1;
+    mm_flush_page_cache();
 
-    while(list_ptr){
+    MM_LOCK(&mm_region_lock);
 
-        printf("VM%d: \n", vm_number);
-        ITERATE_PAGE_FAMILIES_BEGIN(list_ptr, current_family)
+    for(region = partial_regions; region; region = region->next){
 
-            printf("Struct Name: %s, Struct Size: %d\n", current_family->struct_name, current_family->struct_size);
-        ITERATE_PAGE_FAMILIES_END
+        released += mm_region_trim(region);
+    }
 
-        list_ptr = list_ptr->next;
-        ++vm_number;
+    for(region = partial_huge_regions; region; region = region->next){
 
-        printf("\r\n");
+        released += mm_region_trim(region);
     }
 
+    MM_UNLOCK(&mm_region_lock);
+
+    return released;
 }
 
 
 /**
- * find particular struct_name within vm_page_family_list_t
+ * size of the largest free block of a family, only the top size class has to be looked at.
+ * Size class bins keep the largest block of each bin, O(1) unless that block left the top bin
+ * since the last call: then the top bin is walked once, O(free blocks in the bin)
  */ 
-vm_page_family_t* lookup_page_family_by_name(char *struct_name){
+static uint32_t mm_largest_free_block(vm_page_family_t* vm_page_family){
 
-    if(first_vm_page_for_family == NULL){
-        
-        #if MM_DEBUG
-            printf("first_vm_page_for_family should be instantiated first!\n");
-        #endif
-        return NULL;
+    uint32_t largest = 0;
+    glthread_node_t* node = NULL;
+
+#if MM_FREE_BLK_POLICY == MM_SIZE_CLASS_BINS
+    uint32_t bin = 0;
+
+    if(vm_page_family->free_bins_bitmap == 0){
+
+        return 0;
     }
 
-    vm_page_family_list_t* list_ptr = first_vm_page_for_family;
-    vm_page_family_t* current_family = NULL;
+    bin = 31 - __builtin_clz(vm_page_family->free_bins_bitmap);
+    if(vm_page_family->free_bins_stale & (1u << bin)){
 
-    while(list_ptr){
+        for(node = vm_page_family->free_bins[bin].right; node; node = node->right){
 
-        ITERATE_PAGE_FAMILIES_BEGIN(list_ptr, current_family)
-            
-            if(strncmp(current_family->struct_name, struct_name, MAX_NAME_LEN) == 0){
-                return current_family;
+            if(MM_META_BLK_SIZE(glthread_to_meta_block(node)) > largest){
+
+                largest = MM_META_BLK_SIZE(glthread_to_meta_block(node));
             }
-        ITERATE_PAGE_FAMILIES_END
+        }
+        vm_page_family->free_bins_largest[bin] = largest;
+        vm_page_family->free_bins_stale &= ~(1u << bin);
+    }
+
+    largest = vm_page_family->free_bins_largest[bin];
+#else
+    if((node = vm_page_family->free_blks_pq.right) != NULL){
 
-        list_ptr = list_ptr->next;
+        largest = MM_META_BLK_SIZE(glthread_to_meta_block(node));
     }
+#endif
 
-    return NULL;
+    return largest;
 }
 
 
 /**
- * check the vm_page is empty or not
+ * add the counters of a family to a snapshot, the free block list is only walked
+ * for families of the calling thread
  */ 
-vm_bool_t mm_vm_page_is_empty(vm_page_t* vm_page){
-
-    assert(vm_page);
+static void mm_family_stats_add(mm_family_stats_t* family_stats, vm_page_family_t* vm_page_family){
 
-    vm_bool_t ret = vm_page->meta_blk.is_free == MM_TRUE && 
-                    vm_page->meta_blk.next_blk == NULL && 
-                    vm_page->meta_blk.pre_blk == NULL
-                    ? MM_TRUE : MM_FALSE;
+    mm_family_counters_t* counters = &vm_page_family->counters;
+    uint32_t largest = 0;
 
-    return ret;
-}
+    family_stats->counters.pages += __atomic_load_n(&counters->pages, __ATOMIC_RELAXED);
+    family_stats->counters.allocated_blocks += __atomic_load_n(&counters->allocated_blocks, __ATOMIC_RELAXED);
+    family_stats->counters.free_blocks += __atomic_load_n(&counters->free_blocks, __ATOMIC_RELAXED);
+    family_stats->counters.bytes_in_use += __atomic_load_n(&counters->bytes_in_use, __ATOMIC_RELAXED);
+    family_stats->counters.hard_if_bytes += __atomic_load_n(&counters->hard_if_bytes, __ATOMIC_RELAXED);
+    family_stats->counters.soft_if_bytes += __atomic_load_n(&counters->soft_if_bytes, __ATOMIC_RELAXED);
 
+#if MM_THREAD_SAFE
+    if(vm_page_family->heap != mm_thread_heap){
 
-/**
- * VM Page Insertion
- */ 
-vm_page_t* allocate_vm_page(vm_page_family_t* vm_page_family){
+        return;
+    }
+#endif
 
-    if(vm_page_family == NULL){
+    if((largest = mm_largest_free_block(vm_page_family)) > family_stats->largest_free_block){
 
-        #if MM_DEBUG
-            printf("Insert VM Page is NULL!\n");
-        #endif
-        return NULL;
+        family_stats->largest_free_block = largest;
     }
+}
 
-    vm_page_t* new_page = mm_get_vm_page(1);
 
-    /* set the back pointer to page family */
-    new_page->page_family = vm_page_family;
+/**
+ * snapshot of the memory manager, costs O(families): fills stats and one family_stats entry
+ * per registered family up to max_families, return the entries filled in. The largest free block
+ * is kept by the free lists, only the top bin of a family whose largest block was taken since the
+ * last snapshot is walked again, see mm_largest_free_block().
+ * In concurrent mode the counters are summed over all heaps, the largest free block only
+ * covers the heap of the calling thread.
+ */ 
+uint32_t mm_get_stats(mm_stats_t* stats, mm_family_stats_t* family_stats, uint32_t max_families){
 
-    /* meta block init */
-    MARK_VM_PAGE_EMPTY(new_page);
-    glthread_init(&new_page->meta_blk.priority_thread_glue);
-    new_page->meta_blk.data_blk_size = mm_max_page_allocatable_memory(1);
-    new_page->meta_blk.offset = offset_of(vm_page_t, meta_blk);
-    new_page->pre_page = NULL;
-    new_page->next_page = NULL;
+    vm_page_family_t* current_family = NULL;
+    uint32_t filled = 0;
+    uint32_t count = 0;
 
-    /* mantain vm_page_t dll */
-    if(vm_page_family->first_page == NULL){
+    if(stats == NULL || (family_stats == NULL && max_families)){
 
-        vm_page_family->first_page = new_page;
-        return new_page;
+        return 0;
     }
 
-    new_page->next_page = vm_page_family->first_page;
-    vm_page_family->first_page->pre_page = new_page;
-    vm_page_family->first_page = new_page;
+    memset(stats, 0x0, sizeof(mm_stats_t));
 
-    return new_page;
-}
+#if MM_THREAD_SAFE
+    pthread_rwlock_rdlock(&mm_registry_lock);
+    pthread_mutex_lock(&mm_heap_list_lock);
+#endif
 
+    count = mm_registered_family_count();
+    stats->family_count = count;
 
-/**
- * VM Page Deletion
- */ 
-void mm_page_delete_and_free(vm_page_t* vm_page){
+    for(uint32_t family_id=0; family_id<count && filled<max_families; family_id++){
 
-    if(vm_page == NULL){
+        current_family = mm_registered_family(family_id);
 
-        #if MM_DEBUG
-            printf("Delete VM Page is NULL!\n");
-        #endif
-        return;
-    }
+        mm_family_stats_t* entry = &family_stats[filled++];
 
-    /* vm_page is the first page */
-    if(vm_page->page_family->first_page == vm_page){
+        memset(entry, 0x0, sizeof(mm_family_stats_t));
+        memcpy(entry->struct_name, current_family->struct_name, MAX_NAME_LEN);
+        entry->struct_size = current_family->struct_size;
+#if MM_QUOTAS
+        entry->quota.max_pages = __atomic_load_n(&current_family->quota.max_pages, __ATOMIC_RELAXED);
+        entry->quota.max_bytes = __atomic_load_n(&current_family->quota.max_bytes, __ATOMIC_RELAXED);
+        entry->quota.pages = __atomic_load_n(&current_family->quota.pages, __ATOMIC_RELAXED);
+        entry->quota.bytes = __atomic_load_n(&current_family->quota.bytes, __ATOMIC_RELAXED);
+        entry->quota.peak_pages = __atomic_load_n(&current_family->quota.peak_pages, __ATOMIC_RELAXED);
+        entry->quota.peak_bytes = __atomic_load_n(&current_family->quota.peak_bytes, __ATOMIC_RELAXED);
+        entry->quota.failures = __atomic_load_n(&current_family->quota.failures, __ATOMIC_RELAXED);
+#endif
 
-        vm_page->page_family->first_page = vm_page->next_page;
-        if(vm_page->next_page){
+#if MM_THREAD_SAFE
+        uint32_t chunk = current_family->family_id / MM_HEAP_FAMILIES_PER_CHUNK;
+        uint32_t slot = current_family->family_id % MM_HEAP_FAMILIES_PER_CHUNK;
 
-            vm_page->pre_page = NULL;
-        }
-        vm_page->pre_page = NULL;
-        vm_page->next_page = NULL;
-        mm_release_vm_page(vm_page, 1);
-        return;
-    }
+        for(mm_heap_t* heap = first_heap; heap && chunk < MM_HEAP_MAX_FAMILY_CHUNKS; heap = heap->next){
 
-    /* vm_page is at the middle of the dll */
-    vm_page->pre_page->next_page = vm_page->next_page;
-    if(vm_page->next_page){
+            vm_page_family_t** families = __atomic_load_n(&heap->families[chunk], __ATOMIC_ACQUIRE);
+            vm_page_family_t* local_family = families ? __atomic_load_n(&families[slot], __ATOMIC_ACQUIRE) : NULL;
 
-        vm_page->next_page->pre_page = vm_page->pre_page;
+            if(local_family){
+
+                mm_family_stats_add(entry, local_family);
+            }
+        }
+#else
+        mm_family_stats_add(entry, current_family);
+#endif
     }
-    vm_page->pre_page = NULL;
-    vm_page->next_page = NULL;
-    mm_release_vm_page(vm_page, 1);
-}
 
+#if MM_THREAD_SAFE
+    pthread_mutex_unlock(&mm_heap_list_lock);
+    pthread_rwlock_unlock(&mm_registry_lock);
+#endif
 
-/**
- * test function 
- */
-void mm_debug_fn(){
-    
-    mm_init();
-    printf("VM Page Size: %lu\n", SYSTEM_PAGE_SIZE);
+    MM_LOCK(&mm_region_lock);
+    stats->region_count = region_count;
+    stats->released_pages = released_page_count;
+    MM_UNLOCK(&mm_region_lock);
 
-    void* addr1 = mm_get_vm_page(1);
-    void* addr2 = mm_get_vm_page(1);
-    printf("VM1: %p, VM2: %p\n", addr1, addr2);
+    MM_LOCK(&mm_page_cache_lock);
+    stats->global_cached_pages = global_page_cache_count;
+    MM_UNLOCK(&mm_page_cache_lock);
 
-    mm_release_vm_page(addr1, 1);
-    mm_release_vm_page(addr2, 1);
+    return filled;
 }
 
 
+#if MM_LATENCY_HIST
 /**
- * dynamic memory allocation fnuc for applications
+ * add the histograms and split counters of a family to stats
  */ 
-void* zalloc(char* struct_name, int units){
+static void mm_latency_stats_add(mm_latency_stats_t* stats, vm_page_family_t* vm_page_family){
 
-    if(struct_name == NULL || units == 0){
+    for(uint32_t op=0; op<MM_HIST_OPS; op++){
 
-        return NULL;
+        for(uint32_t bucket=0; bucket<MM_HIST_BUCKETS; bucket++){
+
+            stats->hist[op][bucket] += __atomic_load_n(&vm_page_family->latency.hist[op][bucket], __ATOMIC_RELAXED);
+        }
     }
 
-    vm_page_family_t* page_family = NULL;
+    for(uint32_t kind=0; kind<MM_SPLIT_KINDS; kind++){
 
-    if((page_family = lookup_page_family_by_name(struct_name)) == NULL){
+        stats->splits[kind] += __atomic_load_n(&vm_page_family->latency.splits[kind], __ATOMIC_RELAXED);
+    }
+}
 
-        #if MM_DEBUG
-            printf("structure %s can't be found!\n", struct_name);
-        #endif
 
-        return NULL;
+/**
+ * latency histograms and split counters of a registered page family, summed over all heaps in concurrent mode
+ */ 
+vm_bool_t mm_get_latency_stats(vm_page_family_t* page_family, mm_latency_stats_t* stats){
+
+    if(page_family == NULL || stats == NULL){
+
+        return MM_FALSE;
     }
 
-    uint32_t total_struct_size = page_family->struct_size * units;
-    meta_blk_t* free_blk = NULL;
+    memset(stats, 0x0, sizeof(mm_latency_stats_t));
 
-    if(total_struct_size > mm_max_page_allocatable_memory(1)){
+#if MM_THREAD_SAFE
+    uint32_t chunk = page_family->family_id / MM_HEAP_FAMILIES_PER_CHUNK;
+    uint32_t slot = page_family->family_id % MM_HEAP_FAMILIES_PER_CHUNK;
 
-        #if MM_DEBUG
-            printf("Memory requested exeeds page size!\n");
-        #endif
+    pthread_mutex_lock(&mm_heap_list_lock);
 
-        return NULL; // can add extra operation to this senario
-    }
+    for(mm_heap_t* heap = first_heap; heap && chunk < MM_HEAP_MAX_FAMILY_CHUNKS; heap = heap->next){
 
-    free_blk = mm_allocate_free_data_block(page_family, total_struct_size);
+        vm_page_family_t** families = __atomic_load_n(&heap->families[chunk], __ATOMIC_ACQUIRE);
+        vm_page_family_t* local_family = families ? __atomic_load_n(&families[slot], __ATOMIC_ACQUIRE) : NULL;
 
-    if(free_blk){
+        if(local_family){
 
-        memset(free_blk + 1, 0x0, total_struct_size);
-        return free_blk + 1;
+            mm_latency_stats_add(stats, local_family);
+        }
     }
 
-    return NULL;
+    pthread_mutex_unlock(&mm_heap_list_lock);
+#else
+    mm_latency_stats_add(stats, page_family);
+#endif
+
+    return MM_TRUE;
 }
 
 
 /**
- * 
+ * print the non-empty histogram buckets and the split counters of every registered page family
  */ 
-void zfree(void* addr){
-
-    meta_blk_t* free_blk = GET_META_BLK(addr);
-    assert(free_blk->is_free == MM_FALSE);
-    mm_free_blocks(free_blk);
-}
+void mm_print_latency_stats(){
 
+    static const char* op_names[MM_HIST_OPS] = {"zalloc", "zfree", "page acquire", "page release"};
+    uint32_t count = mm_registered_family_count();
+    vm_page_family_t* current_family = NULL;
+    mm_latency_stats_t stats;
 
-/**
- * 
- */ 
-void mm_print_memory_usage(){
+    for(uint32_t family_id=0; family_id<count; family_id++){
 
-    if(first_vm_page_for_family == NULL){
-        
-        #if MM_DEBUG
-            printf("first_vm_page_for_family should be instantiated first!\n");
-        #endif
-        return;
-    }
+        current_family = mm_registered_family(family_id);
+        mm_get_latency_stats(current_family, &stats);
+        printf("Struct Name: %s\n", current_family->struct_name);
+        printf("\tsplits: none = %lu, soft IF = %lu, hard IF = %lu, full = %lu\n",
+                stats.splits[MM_SPLIT_NONE], stats.splits[MM_SPLIT_SOFT_IF],
+                stats.splits[MM_SPLIT_HARD_IF], stats.splits[MM_SPLIT_FULL]);
 
-    vm_page_family_list_t* list_ptr = first_vm_page_for_family;
-    vm_page_family_t* current_family = NULL;
-    uint32_t count = 1;
-    uint32_t total_page = 0;
+        for(uint32_t op=0; op<MM_HIST_OPS; op++){
 
-    while(list_ptr){
+            printf("\t%-13s", op_names[op]);
+            for(uint32_t bucket=0; bucket<MM_HIST_BUCKETS; bucket++){
 
-        printf(ANSI_COLOR_GREEN "VM Family Page %d size = %ld\n" ANSI_COLOR_RESET, count++ ,SYSTEM_PAGE_SIZE);
-        ITERATE_PAGE_FAMILIES_BEGIN(list_ptr, current_family)
-            total_page += mm_print_meta_block_usage(current_family);
-        ITERATE_PAGE_FAMILIES_END
+                if(stats.hist[op][bucket]){
 
-        list_ptr = list_ptr->next;
+                    printf(" 2^%u: %lu", bucket, stats.hist[op][bucket]);
+                }
+            }
+            printf("\n");
+        }
     }
-
-    printf("Total Memory being used by Memory Manager = %lu\n", total_page*SYSTEM_PAGE_SIZE);
 }
+#endif
@@ -27,6 +27,12 @@ typedef struct _teacher{
 }teacher_t;
 
 
+typedef struct _s100{
+
+    uint8_t bytes[100];
+}s100_t;
+
+
 void testapp_demo(){
 
     int wait;
@@ -79,3 +85,34 @@ void testapp_demo(){
 #endif
     
 }
+
+
+/**
+ * zrealloc() zeroes the bytes past the old object, also for an object that was not zeroed
+ * and whose block was rounded up
+ */ 
+void testapp_realloc_nozero(){
+
+    mm_init();
+
+    vm_page_family_t* s100_family = MM_REG_STRUCT(s100_t);
+
+    /* leave old data where the next object and its rounding tail go */
+    uint8_t* old = zalloc_family(s100_family, 4);
+    memset(old, 0xab, 4 * sizeof(s100_t));
+    zfree(old);
+
+    uint8_t* obj = zalloc_family_nozero(s100_family, 3);
+    memset(obj, 0xcd, 3 * sizeof(s100_t));
+
+    obj = zrealloc(obj, 9);
+    assert(obj);
+
+    for(uint32_t i = 3 * sizeof(s100_t); i < 9 * sizeof(s100_t); i++){
+
+        assert(obj[i] == 0);
+    }
+
+    zfree(obj);
+    printf("testapp_realloc_nozero: OK\n");
+}
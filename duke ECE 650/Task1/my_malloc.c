@@ -2,6 +2,14 @@
 
 META_LIST_INIT(meta_blk_list);
 
+#if (MY_TRACE)
+static mm_trace_header_t* trace = NULL;
+static bool trace_opened = false;
+static uint64_t trace_last_ns = 0;
+static uint32_t trace_next_id = 0;
+static mm_trace_map_t trace_map = {NULL, 0, 0};
+#endif
+
 
 /**
  * Get Virtual Memory form kernel
@@ -272,12 +280,124 @@ unsigned long get_total_free_size(){
 }
 
 
+#if (MY_TRACE)
+/**
+ * map the trace ring file $MM_TRACE_FILE on the first malloc
+ */ 
+static void trace_open(){
+
+    const char* path = getenv("MM_TRACE_FILE");
+    size_t length = sizeof(mm_trace_header_t) + (size_t)TRACE_RECORDS * sizeof(mm_trace_record_t);
+    struct timespec ts;
+    int fd = -1;
+
+    trace_opened = true;
+
+    if(path == NULL || (fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1){
+
+        return;
+    }
+
+    if(ftruncate(fd, length) == 0){
+
+        trace = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        trace = trace == MAP_FAILED ? NULL : trace;
+    }
+
+    close(fd);
+
+    if(trace == NULL){
+
+        #if (MY_DEBUG)
+            printf("[Info]: Fail to map trace file %s!\n", path);
+        #endif
+        return;
+    }
+
+    trace->magic = MM_TRACE_MAGIC;
+    trace->version = MM_TRACE_VERSION;
+    trace->record_size = sizeof(mm_trace_record_t);
+    trace->capacity = TRACE_RECORDS;
+    trace->families[First_Fit].struct_size = 1;
+    strcpy(trace->families[First_Fit].struct_name, "ff_malloc");
+    trace->families[Best_Fit].struct_size = 1;
+    strcpy(trace->families[Best_Fit].struct_name, "bf_malloc");
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    trace_last_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+/**
+ * append a record to the ring, the oldest record is overwritten once it is full
+ */ 
+static void trace_append(mm_trace_op_t op, uint16_t family_id, uint32_t size, uint32_t object_id){
+
+    mm_trace_record_t* record = &trace->records[trace->head % trace->capacity];
+    struct timespec ts;
+    uint64_t now = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+    record->op = op;
+    record->align_shift = 0;
+    record->family_id = family_id;
+    record->units = size;
+    record->object_id = object_id;
+    record->delta_ns = now - trace_last_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)(now - trace_last_ns);
+    trace_last_ns = now;
+    trace->head++;
+}
+
+
+/**
+ * record a malloc
+ */ 
+static void trace_malloc(void* addr, size_t size, MALLOC_VERSION version){
+
+    if(!trace_opened){
+
+        trace_open();
+    }
+
+    if(trace == NULL || addr == NULL){
+
+        return;
+    }
+
+    mm_trace_map_put(&trace_map, (uintptr_t)addr, trace_next_id, version);
+    trace_append(MM_TRACE_ALLOC, version, size, trace_next_id++);
+}
+
+
+/**
+ * record a free, blocks allocated before the trace was opened are not in the map
+ */ 
+static void trace_free(void* addr){
+
+    mm_trace_slot_t entry;
+
+    if(trace && mm_trace_map_take(&trace_map, (uintptr_t)addr, &entry)){
+
+        trace_append(MM_TRACE_FREE, entry.family_id, 0, entry.object_id);
+    }
+}
+#endif
+
+
 /**
  * first fit malloc func
  */ 
 void* ff_malloc(size_t size){
 
-    return memory_allocation_process(size, First_Fit);
+    void* addr = memory_allocation_process(size, First_Fit);
+
+    #if (MY_TRACE)
+        trace_malloc(addr, size, First_Fit);
+    #endif
+
+    return addr;
 }
 
 
@@ -286,7 +406,13 @@ void* ff_malloc(size_t size){
  */ 
 void* bf_malloc(size_t size){
 
-    return memory_allocation_process(size, Best_Fit);
+    void* addr = memory_allocation_process(size, Best_Fit);
+
+    #if (MY_TRACE)
+        trace_malloc(addr, size, Best_Fit);
+    #endif
+
+    return addr;
 }
 
 
@@ -295,6 +421,10 @@ void* bf_malloc(size_t size){
  */ 
 void ff_free(void* addr){
 
+    #if (MY_TRACE)
+        trace_free(addr);
+    #endif
+
     memory_free_process(addr);
 }
 
@@ -304,6 +434,10 @@ void ff_free(void* addr){
  */ 
 void bf_free(void* addr){
 
+    #if (MY_TRACE)
+        trace_free(addr);
+    #endif
+
     memory_free_process(addr);
 }
 
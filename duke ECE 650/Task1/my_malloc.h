@@ -12,7 +12,21 @@
 
 #define DEBUG_ON    1
 #define DEBUG_OFF   0
+#ifndef MY_DEBUG
 #define MY_DEBUG    DEBUG_ON
+#endif
+
+/* record every malloc and free into the ring file $MM_TRACE_FILE */
+#ifndef MY_TRACE
+#define MY_TRACE    0
+#endif
+
+#if (MY_TRACE)
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "../../Heap Memory Manager/include/mm_trace.h"
+#endif
 
 #define GET_VM_SIZE 1024
 #define META_SIZE   sizeof(META_BLK)
@@ -72,6 +86,14 @@ typedef enum _MALLOC_VERSION{
     Best_Fit = 1
 }MALLOC_VERSION;
 
+#if (MY_TRACE)
+/*
+ * the trace is written in the format of the Heap Memory Manager, whose mm_replay tool replays it,
+ * sizes are recorded in bytes of 1 byte families: family 0 is first fit, family 1 best fit
+ */
+#define TRACE_RECORDS       (1u << 20)
+#endif
+
 void* ff_malloc(size_t size);
 void ff_free(void* addr);
 void* bf_malloc(size_t size);